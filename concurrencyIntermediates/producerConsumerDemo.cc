@@ -3,23 +3,25 @@
 #include <mutex>
 #include <stack>
 #include <thread>
+#include <utility>
 #include <vector>
 
-template <std::integral T> class ThreadSafeStack {
+// The mutex baseline; src/MpmcQueue.h is the lock-free ring that grew out of it
+template <std::movable T> class ThreadSafeStack {
   private:
-    std::stack<int> priStack{};
+    std::stack<T> priStack{};
     std::mutex stackMutex;
 
   public:
     void push(T newValue) {
         std::scoped_lock stackGuard(stackMutex);
-        priStack.push(newValue);
+        priStack.push(std::move(newValue));
     }
     bool try_pop(T& value) {
         std::scoped_lock stackGuard(stackMutex);
         if(priStack.empty())
             return false;
-        value = priStack.top();
+        value = std::move(priStack.top());
         priStack.pop();
         return true;
     }
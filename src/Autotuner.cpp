@@ -0,0 +1,224 @@
+#include "Autotuner.h"
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+namespace {
+using Method = ImageProcessor::SatMethod;
+
+std::optional<Method> parseMethod(const std::string& name) {
+    for(Method method : {Method::SERIAL, Method::WAVEFRONT_PIPELINE, Method::TWO_PASS_BARRIER}) {
+        if(name == satMethodName(method)) {
+            return method;
+        }
+    }
+    return std::nullopt;
+}
+
+std::vector<SatTuning> candidates() {
+    int cores = static_cast<int>(std::max(2u, std::thread::hardware_concurrency()));
+    std::vector<SatTuning> list{{Method::SERIAL, 32, 1}};
+    for(int batch : {8, 16, 32, 64, 128})
+        list.push_back({Method::WAVEFRONT_PIPELINE, batch, 2});
+    for(int threads{2}; threads <= cores; threads *= 2)
+        list.push_back({Method::TWO_PASS_BARRIER, 32, threads});
+    if(!std::has_single_bit(static_cast<unsigned>(cores))) {
+        list.push_back({Method::TWO_PASS_BARRIER, 32, cores});
+    }
+    return list;
+}
+
+double median(std::vector<double> samples) {
+    std::sort(samples.begin(), samples.end());
+    return samples[samples.size() / 2];
+}
+} // namespace
+
+const char* satMethodName(ImageProcessor::SatMethod method) {
+    switch(method) {
+    case Method::SERIAL: return "serial";
+    case Method::WAVEFRONT_PIPELINE: return "wavefront";
+    case Method::TWO_PASS_BARRIER: return "two_pass";
+    }
+    return "two_pass";
+}
+
+bool TuningTable::load(const std::string& path) {
+    std::ifstream in(path);
+    if(!in) {
+        return false;
+    }
+    for(std::string line; std::getline(in, line);) {
+        if(line.empty() || line[0] == '#') {
+            continue;
+        }
+        // cpu \t size class \t method \t batch \t threads
+        std::vector<std::string> fields;
+        std::stringstream row(line);
+        for(std::string field; std::getline(row, field, '\t');)
+            fields.push_back(field);
+        std::optional<Method> method = fields.size() == 5 ? parseMethod(fields[2]) : std::nullopt;
+        if(!method) {
+            continue;
+        }
+        try {
+            entries[{fields[0], std::stoi(fields[1])}] =
+                SatTuning{*method, std::stoi(fields[3]), std::stoi(fields[4])};
+        } catch(const std::exception&) {
+            // A line we can't read is just retuned
+        }
+    }
+    return true;
+}
+
+bool TuningTable::save(const std::string& path) const {
+    std::error_code ec;
+    std::filesystem::path target(path);
+    if(target.has_parent_path()) {
+        std::filesystem::create_directories(target.parent_path(), ec);
+    }
+    // Written aside and renamed, so a worker loading it concurrently never sees half a table
+    std::string temporary = path + ".tmp" + std::to_string(std::hash<std::thread::id>{}(
+                                                std::this_thread::get_id()));
+    {
+        std::ofstream out(temporary);
+        if(!out) {
+            return false;
+        }
+        out << "# cpu\tsize_class\tmethod\tbatch\tthreads\n";
+        for(const auto& [key, tuning] : entries) {
+            out << key.first << '\t' << key.second << '\t' << satMethodName(tuning.method) << '\t'
+                << tuning.batchSize << '\t' << tuning.threads << '\n';
+        }
+        if(!out) {
+            return false;
+        }
+    }
+    std::filesystem::rename(temporary, target, ec);
+    return !ec;
+}
+
+std::optional<SatTuning> TuningTable::lookup(const std::string& cpu, int sizeClass) const {
+    auto it = entries.find({cpu, sizeClass});
+    if(it == entries.end()) {
+        return std::nullopt;
+    }
+    return it->second;
+}
+
+void TuningTable::set(const std::string& cpu, int sizeClass, const SatTuning& tuning) {
+    entries[{cpu, sizeClass}] = tuning;
+}
+
+std::string cpuKey() {
+    std::string model{"unknown"};
+    std::ifstream in("/proc/cpuinfo");
+    for(std::string line; std::getline(in, line);) {
+        if(line.starts_with("model name")) {
+            model = line.substr(line.find(':') + 1);
+            model.erase(0, model.find_first_not_of(" \t"));
+            break;
+        }
+    }
+    std::replace(model.begin(), model.end(), '\t', ' ');
+    return model + " x" + std::to_string(std::max(1u, std::thread::hardware_concurrency()));
+}
+
+int sizeClass(int width, int height) {
+    double pixels = std::max(1.0, static_cast<double>(width) * height);
+    return static_cast<int>(std::lround(std::log2(pixels) / 2.0));
+}
+
+std::string tuningTablePath() {
+    if(const char* path = std::getenv("OPTIC_TUNING_FILE")) {
+        return path;
+    }
+    if(const char* cache = std::getenv("XDG_CACHE_HOME")) {
+        return std::string(cache) + "/optic/sat_tuning.tsv";
+    }
+    if(const char* home = std::getenv("HOME")) {
+        return std::string(home) + "/.cache/optic/sat_tuning.tsv";
+    }
+    return "sat_tuning.tsv";
+}
+
+SatTuning tuneSat(int sizeClass, int repeats) {
+    int side = 1 << std::clamp(sizeClass, 4, 11);
+    std::vector<uint8_t> rgba(static_cast<size_t>(side) * side * 4);
+    uint32_t state = 0x9E3779B9u;
+    for(auto& byte : rgba) {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        byte = static_cast<uint8_t>(state);
+    }
+
+    ImageProcessor processor;
+    // The engine's progress lines would drown the result. Muted on this processor only, so
+    // --serve / --batch workers running alongside keep their output
+    processor.setQuiet(true);
+    processor.loadRgba(rgba.data(), side, side);
+    SatTuning best;
+    double bestMs{-1.0};
+    for(const SatTuning& candidate : candidates()) {
+        processor.setSatTuning(candidate);
+        std::vector<double> samples;
+        // One untimed run first to fault in the buffers
+        for(int r{0}; r <= repeats; r++) {
+            processor.applyFilter(3, "sat");
+            for(const auto& stage : processor.getTimings().getStages()) {
+                if(stage.name == "sat" && r > 0) {
+                    samples.push_back(stage.ns / 1e6);
+                }
+            }
+        }
+        double ms = median(samples);
+        if(bestMs < 0 || ms < bestMs) {
+            bestMs = ms;
+            best = candidate;
+        }
+    }
+    return best;
+}
+
+SatTuning tunedSat(int width, int height) {
+#ifdef __EMSCRIPTEN__
+    return SatTuning{};
+#else
+    static std::mutex lock;
+    static std::optional<TuningTable> table;
+    static const std::string cpu = cpuKey();
+    int sizeClassKey = sizeClass(width, height);
+
+    // Held while tuning too, so concurrent workers don't tune (and skew) the same class
+    std::lock_guard<std::mutex> lk(lock);
+    if(!table) {
+        table.emplace();
+        table->load(tuningTablePath());
+    }
+    if(std::optional<SatTuning> known = table->lookup(cpu, sizeClassKey)) {
+        return *known;
+    }
+    const char* autotune = std::getenv("OPTIC_AUTOTUNE");
+    if(autotune && std::string(autotune) == "0") {
+        return SatTuning{};
+    }
+    SatTuning tuning = tuneSat(sizeClassKey);
+    table->set(cpu, sizeClassKey, tuning);
+    if(!table->save(tuningTablePath())) {
+        std::cerr << "[C++] Cannot save SAT tuning to " << tuningTablePath() << '\n';
+    }
+    std::cout << "[C++] Tuned SAT for size class " << sizeClassKey << ": "
+              << satMethodName(tuning.method) << ", batch " << tuning.batchSize << ", "
+              << tuning.threads << " threads" << std::endl;
+    return tuning;
+#endif
+}
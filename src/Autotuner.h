@@ -0,0 +1,46 @@
+#ifndef AUTOTUNER_H
+#define AUTOTUNER_H
+
+#include "ImageProcessor.h"
+#include <map>
+#include <optional>
+#include <string>
+#include <utility>
+
+// Per-machine choice of SAT method, wavefront batch size and two-pass thread count.
+// Results live in a small tab-separated table keyed by CPU model (plus core count) and image
+// size class, at $OPTIC_TUNING_FILE or ~/.cache/optic/sat_tuning.tsv, so each worker type
+// tunes itself once. ppm_cli --tune fills the table up front; otherwise tunedSat() tunes a
+// missing size class the first time an image of that size asks for it. OPTIC_AUTOTUNE=0
+// skips tuning and falls back to the built-in defaults for anything not in the table.
+using SatTuning = ImageProcessor::SatTuning;
+
+class TuningTable {
+  public:
+    bool load(const std::string& path);
+    bool save(const std::string& path) const;
+
+    std::optional<SatTuning> lookup(const std::string& cpu, int sizeClass) const;
+    void set(const std::string& cpu, int sizeClass, const SatTuning& tuning);
+
+    const std::map<std::pair<std::string, int>, SatTuning>& getEntries() const {
+        return entries;
+    }
+
+  private:
+    std::map<std::pair<std::string, int>, SatTuning> entries;
+};
+
+// "Intel(R) Xeon(R) ... x16": /proc/cpuinfo model name and hardware threads
+std::string cpuKey();
+// round(log2(sqrt(pixels))): 256x256 -> 8, 4096x4096 -> 12
+int sizeClass(int width, int height);
+std::string tuningTablePath();
+
+// Times every candidate on a synthetic image of the class's size (capped at 2048x2048)
+SatTuning tuneSat(int sizeClass, int repeats = 3);
+// Table entry for this machine and size, tuning and saving it first if it's missing
+SatTuning tunedSat(int width, int height);
+
+const char* satMethodName(ImageProcessor::SatMethod method);
+#endif
@@ -0,0 +1,500 @@
+#include "BatchPipeline.h"
+#include "BoundedQueue.h"
+#include "ImageProcessor.h"
+#include "IoRing.h"
+#include "PpmWriter.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <fcntl.h>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <span>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+
+namespace {
+using Clock = std::chrono::steady_clock;
+
+struct Job {
+    size_t index{0};
+    std::vector<uint8_t> bytes; // encoded input until decode, the P6 file after encode
+    std::unique_ptr<ImageProcessor> processor;
+};
+
+constexpr size_t queueDepth = 2;
+// Decoded frames are the big allocation, this caps how many exist at once
+constexpr size_t processorsInFlight = 4;
+constexpr size_t maxChunk = size_t{1} << 30;
+
+class Batch {
+  public:
+    Batch(const std::vector<std::string>& _inputs, const std::string& outputDir, int _ioDepth)
+        : inputs(_inputs), ioDepth(std::max(1, _ioDepth)), processors(processorsInFlight) {
+        for(const auto& input : inputs) {
+            std::filesystem::path name = std::filesystem::path(input).stem();
+            name += ".ppm";
+            outputs.push_back((std::filesystem::path(outputDir) / name).string());
+        }
+        for(size_t i{0}; i < processorsInFlight; i++) {
+            processors.push(std::make_unique<ImageProcessor>());
+        }
+    }
+
+    const std::vector<std::string>& inputs;
+    std::vector<std::string> outputs;
+    int ioDepth;
+
+    BoundedQueue<Job> readQueue{queueDepth};
+    BoundedQueue<Job> decodedQueue{queueDepth};
+    BoundedQueue<Job> filteredQueue{queueDepth};
+    BoundedQueue<Job> writeQueue{queueDepth};
+    BoundedQueue<std::unique_ptr<ImageProcessor>> processors;
+
+    std::atomic<int> written{0};
+    std::atomic<int> failed{0};
+    std::atomic<uint64_t> bytesRead{0};
+    std::atomic<uint64_t> bytesWritten{0};
+    std::atomic<int64_t> busyNs[static_cast<size_t>(BatchStage::COUNT)]{};
+
+    void addBusy(BatchStage stage, Clock::time_point since) {
+        busyNs[static_cast<size_t>(stage)] +=
+            std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - since).count();
+    }
+    void fail(size_t index, const char* what) {
+        failed++;
+        std::cerr << "[C++] batch: " << what << " failed for " << inputs[index] << '\n';
+    }
+    void recycle(Job& job) {
+        if(job.processor) {
+            processors.push(std::move(job.processor));
+        }
+    }
+
+    void readWithRing(IoRing& ring);
+    void readWithPool();
+    void writeWithRing(IoRing& ring);
+    void writeWithPool();
+};
+
+struct InFlight {
+    Job job;
+    int fd{-1};
+    size_t done{0};
+};
+
+void Batch::readWithRing(IoRing& ring) {
+    std::vector<InFlight> slots(ioDepth);
+    std::vector<size_t> freeSlots;
+    for(size_t s{0}; s < slots.size(); s++)
+        freeSlots.push_back(s);
+    auto submit = [&](size_t slot) {
+        InFlight& f = slots[slot];
+        size_t len = std::min(maxChunk, f.job.bytes.size() - f.done);
+        return ring.queueRead(f.fd, f.job.bytes.data() + f.done, static_cast<unsigned>(len),
+                              f.done, slot);
+    };
+
+    Clock::time_point start = Clock::now();
+    Clock::duration blocked{};
+    size_t next{0};
+    int inFlight{0};
+    while(next < inputs.size() || inFlight > 0) {
+        while(inFlight < ioDepth && next < inputs.size()) {
+            size_t index = next++;
+            int fd = ::open(inputs[index].c_str(), O_RDONLY);
+            struct stat st{};
+            if(fd < 0 || fstat(fd, &st) != 0 || st.st_size == 0) {
+                if(fd >= 0) {
+                    ::close(fd);
+                }
+                fail(index, "open");
+                continue;
+            }
+            size_t slot = freeSlots.back();
+            freeSlots.pop_back();
+            slots[slot] = InFlight{};
+            slots[slot].job.index = index;
+            slots[slot].job.bytes.resize(st.st_size);
+            slots[slot].fd = fd;
+            submit(slot);
+            inFlight++;
+        }
+        if(inFlight == 0) {
+            break;
+        }
+        uint64_t slot;
+        int result;
+        if(!ring.nextCompletion(slot, result, true)) {
+            std::cerr << "[C++] batch: io_uring_enter failed, abandoning reads" << '\n';
+            failed += inFlight + static_cast<int>(inputs.size() - next);
+            break;
+        }
+        InFlight& f = slots[slot];
+        if(result > 0) {
+            f.done += result;
+            bytesRead += result;
+            if(f.done < f.job.bytes.size()) {
+                submit(slot);
+                continue;
+            }
+        }
+        ::close(f.fd);
+        inFlight--;
+        freeSlots.push_back(slot);
+        if(result <= 0) {
+            fail(f.job.index, "read");
+            continue;
+        }
+        Clock::time_point pushStart = Clock::now();
+        readQueue.push(std::move(f.job));
+        blocked += Clock::now() - pushStart;
+    }
+    busyNs[static_cast<size_t>(BatchStage::READ)] +=
+        std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start - blocked)
+            .count();
+    readQueue.close();
+}
+
+void Batch::readWithPool() {
+    std::atomic<size_t> next{0};
+    std::atomic<int> running{ioDepth};
+    auto worker = [&] {
+        for(size_t index = next++; index < inputs.size(); index = next++) {
+            Clock::time_point start = Clock::now();
+            Job job;
+            job.index = index;
+            int fd = ::open(inputs[index].c_str(), O_RDONLY);
+            struct stat st{};
+            bool ok = fd >= 0 && fstat(fd, &st) == 0 && st.st_size > 0;
+            if(ok) {
+                job.bytes.resize(st.st_size);
+                for(size_t done{0}; ok && done < job.bytes.size();) {
+                    ssize_t got =
+                        ::pread(fd, job.bytes.data() + done, job.bytes.size() - done, done);
+                    ok = got > 0;
+                    done += ok ? got : 0;
+                    bytesRead += ok ? got : 0;
+                }
+            }
+            if(fd >= 0) {
+                ::close(fd);
+            }
+            addBusy(BatchStage::READ, start);
+            if(!ok) {
+                fail(index, "read");
+                continue;
+            }
+            readQueue.push(std::move(job));
+        }
+        if(--running == 0) {
+            readQueue.close();
+        }
+    };
+    std::vector<std::thread> pool;
+    for(int t{0}; t < ioDepth; t++)
+        pool.emplace_back(worker);
+    for(auto& t : pool)
+        t.join();
+}
+
+void Batch::writeWithRing(IoRing& ring) {
+    std::vector<InFlight> slots(ioDepth);
+    std::vector<size_t> freeSlots;
+    for(size_t s{0}; s < slots.size(); s++)
+        freeSlots.push_back(s);
+    auto submit = [&](size_t slot) {
+        InFlight& f = slots[slot];
+        size_t len = std::min(maxChunk, f.job.bytes.size() - f.done);
+        return ring.queueWrite(f.fd, f.job.bytes.data() + f.done, static_cast<unsigned>(len),
+                               f.done, slot);
+    };
+    auto complete = [&](uint64_t slot, int result) {
+        InFlight& f = slots[slot];
+        if(result > 0) {
+            f.done += result;
+            bytesWritten += result;
+            if(f.done < f.job.bytes.size()) {
+                submit(slot);
+                return;
+            }
+        }
+        ::close(f.fd);
+        freeSlots.push_back(slot);
+        if(result <= 0) {
+            fail(f.job.index, "write");
+        } else {
+            written++;
+        }
+        f.job.bytes = {};
+    };
+
+    Clock::time_point start = Clock::now();
+    Clock::duration blocked{};
+    bool draining{false};
+    uint64_t slot;
+    int result;
+    for(;;) {
+        while(ring.nextCompletion(slot, result, false))
+            complete(slot, result);
+        size_t inFlight = slots.size() - freeSlots.size();
+        if(!draining && !freeSlots.empty()) {
+            Clock::time_point popStart = Clock::now();
+            std::optional<Job> job = writeQueue.pop();
+            blocked += Clock::now() - popStart;
+            if(!job) {
+                draining = true;
+                continue;
+            }
+            int fd = ::open(outputs[job->index].c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+            if(fd < 0) {
+                fail(job->index, "open output");
+                continue;
+            }
+            size_t free = freeSlots.back();
+            freeSlots.pop_back();
+            slots[free] = InFlight{std::move(*job), fd, 0};
+            submit(free);
+            continue;
+        }
+        if(inFlight == 0) {
+            break;
+        }
+        if(!ring.nextCompletion(slot, result, true)) {
+            std::cerr << "[C++] batch: io_uring_enter failed, abandoning writes" << '\n';
+            failed += static_cast<int>(inFlight);
+            break;
+        }
+        complete(slot, result);
+    }
+    busyNs[static_cast<size_t>(BatchStage::WRITE)] +=
+        std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start - blocked)
+            .count();
+}
+
+void Batch::writeWithPool() {
+    auto worker = [&] {
+        while(std::optional<Job> job = writeQueue.pop()) {
+            Clock::time_point start = Clock::now();
+            int fd = ::open(outputs[job->index].c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+            bool ok = fd >= 0;
+            for(size_t done{0}; ok && done < job->bytes.size();) {
+                ssize_t put =
+                    ::pwrite(fd, job->bytes.data() + done, job->bytes.size() - done, done);
+                ok = put > 0;
+                done += ok ? put : 0;
+                bytesWritten += ok ? put : 0;
+            }
+            if(fd >= 0) {
+                ::close(fd);
+            }
+            addBusy(BatchStage::WRITE, start);
+            if(ok) {
+                written++;
+            } else {
+                fail(job->index, "write");
+            }
+        }
+    };
+    std::vector<std::thread> pool;
+    for(int t{0}; t < ioDepth; t++)
+        pool.emplace_back(worker);
+    for(auto& t : pool)
+        t.join();
+}
+} // namespace
+
+bool runBatchPipeline(const std::vector<std::string>& inputs, const std::string& outputDir,
+                      const std::string& filterType, int kernelSize, BatchStats* stats,
+                      bool useIoUring, int ioDepth) {
+    std::error_code ec;
+    std::filesystem::create_directories(outputDir, ec);
+    if(ec) {
+        std::cerr << "[C++] Cannot create " << outputDir << ": " << ec.message() << '\n';
+        return false;
+    }
+
+    Batch batch(inputs, outputDir, ioDepth);
+    // Separate rings for the two IO stages, a ring is only ever touched by one thread
+    IoRing readRing, writeRing;
+    bool ioUring = useIoUring && readRing.init(batch.ioDepth * 2) &&
+                   writeRing.init(batch.ioDepth * 2);
+    Clock::time_point start = Clock::now();
+
+    std::thread readThread([&] {
+        if(ioUring) {
+            batch.readWithRing(readRing);
+        } else {
+            batch.readWithPool();
+        }
+    });
+
+    std::thread decodeThread([&] {
+        while(std::optional<Job> job = batch.readQueue.pop()) {
+            std::optional<std::unique_ptr<ImageProcessor>> processor = batch.processors.pop();
+            Clock::time_point t = Clock::now();
+            job->processor = std::move(*processor);
+            bool ok = job->processor->loadImage(std::as_bytes(std::span(job->bytes)));
+            job->bytes = {};
+            batch.addBusy(BatchStage::DECODE, t);
+            if(!ok) {
+                batch.fail(job->index, "decode");
+                batch.recycle(*job);
+                continue;
+            }
+            batch.decodedQueue.push(std::move(*job));
+        }
+        batch.decodedQueue.close();
+    });
+
+    std::thread filterThread([&] {
+        while(std::optional<Job> job = batch.decodedQueue.pop()) {
+            Clock::time_point t = Clock::now();
+            bool ok = job->processor->applyFilter(kernelSize, filterType);
+            batch.addBusy(BatchStage::FILTER, t);
+            if(!ok) {
+                batch.fail(job->index, "filter");
+                batch.recycle(*job);
+                continue;
+            }
+            batch.filteredQueue.push(std::move(*job));
+        }
+        batch.filteredQueue.close();
+    });
+
+    std::thread encodeThread([&] {
+        while(std::optional<Job> job = batch.filteredQueue.pop()) {
+            Clock::time_point t = Clock::now();
+            const ImageProcessor& processor = *job->processor;
+            std::string header = "P6\n" + std::to_string(processor.getWidth()) + " " +
+                                 std::to_string(processor.getHeight()) + "\n255\n";
+            size_t pixels = static_cast<size_t>(processor.getWidth()) * processor.getHeight();
+            job->bytes.resize(header.size() + pixels * 3);
+            std::memcpy(job->bytes.data(), header.data(), header.size());
+            packRGBAtoRGB(reinterpret_cast<const uint8_t*>(processor.getPixelDataPtr()),
+                          job->bytes.data() + header.size(), pixels);
+            batch.recycle(*job);
+            batch.addBusy(BatchStage::ENCODE, t);
+            batch.writeQueue.push(std::move(*job));
+        }
+        batch.writeQueue.close();
+    });
+
+    if(ioUring) {
+        batch.writeWithRing(writeRing);
+    } else {
+        batch.writeWithPool();
+    }
+    readThread.join();
+    decodeThread.join();
+    filterThread.join();
+    encodeThread.join();
+    batch.processors.close();
+
+    if(stats) {
+        stats->images = batch.written;
+        stats->failed = batch.failed;
+        stats->wallMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+        stats->bytesRead = batch.bytesRead;
+        stats->bytesWritten = batch.bytesWritten;
+        stats->ioUring = ioUring;
+        for(size_t s{0}; s < static_cast<size_t>(BatchStage::COUNT); s++)
+            stats->busyMs[s] = batch.busyNs[s] / 1e6;
+    }
+    return batch.failed == 0;
+}
+
+bool runBatchWorkers(const std::string& inputDir, const std::string& outputDir,
+                     const std::string& filterType, int kernelSize, int jobs,
+                     BatchWorkerStats* stats) {
+    struct Input {
+        std::filesystem::path path;
+        uintmax_t size;
+    };
+    std::vector<Input> files;
+    std::error_code ec;
+    for(const auto& entry : std::filesystem::directory_iterator(inputDir, ec)) {
+        if(entry.is_regular_file()) {
+            files.push_back({entry.path(), entry.file_size()});
+        }
+    }
+    if(ec) {
+        std::cerr << "[C++] Cannot list " << inputDir << ": " << ec.message() << '\n';
+        return false;
+    }
+    std::filesystem::create_directories(outputDir, ec);
+    if(ec) {
+        std::cerr << "[C++] Cannot create " << outputDir << ": " << ec.message() << '\n';
+        return false;
+    }
+    std::sort(files.begin(), files.end(),
+              [](const Input& a, const Input& b) { return a.size > b.size; });
+
+    if(jobs <= 0) {
+        jobs = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+    }
+    jobs = std::max(1, std::min<int>(jobs, static_cast<int>(files.size())));
+
+    std::atomic<size_t> next{0};
+    std::atomic<int> failed{0};
+    std::atomic<uint64_t> bytesRead{0};
+    std::vector<std::vector<double>> latencies(jobs);
+    Clock::time_point start = Clock::now();
+
+    auto worker = [&](int id) {
+        ImageProcessor processor;
+        for(size_t i = next++; i < files.size(); i = next++) {
+            Clock::time_point t = Clock::now();
+            const std::filesystem::path& input = files[i].path;
+            std::filesystem::path output = std::filesystem::path(outputDir) / input.stem();
+            output += ".ppm";
+            bool ok = processor.loadImageFromFile(input.string());
+            if(ok) {
+                ok = processor.applyFilter(kernelSize, filterType) &&
+                     writePPM(output.string(),
+                              reinterpret_cast<const uint8_t*>(processor.getPixelDataPtr()),
+                              processor.getWidth(), processor.getHeight());
+            }
+            if(!ok) {
+                failed++;
+                std::cerr << "[C++] batch: failed on " << input << '\n';
+                continue;
+            }
+            bytesRead += files[i].size;
+            latencies[id].push_back(
+                std::chrono::duration<double, std::milli>(Clock::now() - t).count());
+        }
+    };
+    std::vector<std::thread> pool;
+    for(int t{0}; t < jobs; t++)
+        pool.emplace_back(worker, t);
+    for(auto& t : pool)
+        t.join();
+
+    std::vector<double> all;
+    for(const auto& perWorker : latencies)
+        all.insert(all.end(), perWorker.begin(), perWorker.end());
+    std::sort(all.begin(), all.end());
+    // Nearest-rank percentile
+    auto percentile = [&](double p) {
+        if(all.empty()) {
+            return 0.0;
+        }
+        size_t rank = static_cast<size_t>(std::ceil(p * all.size()));
+        return all[std::clamp<size_t>(rank, 1, all.size()) - 1];
+    };
+    if(stats) {
+        stats->images = static_cast<int>(all.size());
+        stats->failed = failed;
+        stats->wallMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+        stats->bytesRead = bytesRead;
+        stats->p50Ms = percentile(0.50);
+        stats->p99Ms = percentile(0.99);
+    }
+    return failed == 0;
+}
@@ -0,0 +1,47 @@
+#ifndef BATCH_PIPELINE_H
+#define BATCH_PIPELINE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+enum class BatchStage { READ, DECODE, FILTER, ENCODE, WRITE, COUNT };
+
+struct BatchStats {
+    int images{0};
+    int failed{0};
+    double wallMs{0};
+    uint64_t bytesRead{0};
+    uint64_t bytesWritten{0};
+    bool ioUring{false};
+    // Time each stage spent working; the sum exceeding wallMs is the overlap
+    double busyMs[static_cast<size_t>(BatchStage::COUNT)]{};
+};
+
+// Filters many files at once as a five-stage pipeline joined by bounded queues:
+// read -> decode -> filter -> encode -> write, each stage on its own thread, so the disk
+// and the CPU are busy at the same time. Reads and writes go through io_uring with up to
+// ioDepth requests in flight, or a pool of ioDepth pread/pwrite threads when the kernel
+// won't give us a ring. Every input becomes <outputDir>/<stem>.ppm.
+bool runBatchPipeline(const std::vector<std::string>& inputs, const std::string& outputDir,
+                      const std::string& filterType, int kernelSize, BatchStats* stats = nullptr,
+                      bool useIoUring = true, int ioDepth = 8);
+
+struct BatchWorkerStats {
+    int images{0};
+    int failed{0};
+    double wallMs{0};
+    uint64_t bytesRead{0};
+    // Per-image load + filter + write time
+    double p50Ms{0};
+    double p99Ms{0};
+};
+
+// Filters every regular file in inputDir with `jobs` worker threads (0 = all cores).
+// Each worker keeps one ImageProcessor for its whole run; files are handed out largest
+// first from a shared counter, so the big ones don't end up straggling at the end.
+bool runBatchWorkers(const std::string& inputDir, const std::string& outputDir,
+                     const std::string& filterType, int kernelSize, int jobs = 0,
+                     BatchWorkerStats* stats = nullptr);
+#endif
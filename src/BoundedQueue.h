@@ -0,0 +1,59 @@
+#ifndef BOUNDED_QUEUE_H
+#define BOUNDED_QUEUE_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <optional>
+
+// Blocking FIFO with a fixed capacity, used to hand bands between pipeline stages.
+// push() waits while full, pop() waits while empty. After close() pushes are dropped and
+// pop() drains what is left, then returns std::nullopt.
+template <typename T> class BoundedQueue {
+  private:
+    std::mutex m;
+    std::condition_variable notFull;
+    std::condition_variable notEmpty;
+    std::deque<T> items;
+    size_t capacity;
+    bool closed{false};
+
+  public:
+    explicit BoundedQueue(size_t _capacity) : capacity(_capacity) {}
+
+    bool push(T item) {
+        std::unique_lock<std::mutex> lk(m);
+        notFull.wait(lk, [&] { return closed || items.size() < capacity; });
+        if(closed) {
+            return false;
+        }
+        items.push_back(std::move(item));
+        lk.unlock();
+        notEmpty.notify_one();
+        return true;
+    }
+
+    std::optional<T> pop() {
+        std::unique_lock<std::mutex> lk(m);
+        notEmpty.wait(lk, [&] { return closed || !items.empty(); });
+        if(items.empty()) {
+            return std::nullopt;
+        }
+        T item = std::move(items.front());
+        items.pop_front();
+        lk.unlock();
+        notFull.notify_one();
+        return item;
+    }
+
+    void close() {
+        {
+            std::lock_guard<std::mutex> lk(m);
+            closed = true;
+        }
+        notFull.notify_all();
+        notEmpty.notify_all();
+    }
+};
+#endif
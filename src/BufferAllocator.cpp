@@ -0,0 +1,139 @@
+#include "BufferAllocator.h"
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+
+#if defined(__linux__) && !defined(__EMSCRIPTEN__)
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#define OPTIC_HAVE_MMAP_BACKEND 1
+#endif
+
+namespace {
+constexpr size_t cacheLine = 64;
+constexpr size_t hugePage = size_t{2} << 20;
+
+#ifdef OPTIC_HAVE_MMAP_BACKEND
+bool useMmapBackend(size_t bytes) {
+    size_t threshold = allocatorConfig().hugePageThreshold;
+    return threshold != 0 && bytes >= threshold;
+}
+
+size_t roundToHugePages(size_t bytes) { return (bytes + hugePage - 1) / hugePage * hugePage; }
+
+void* mapHugeRegion(size_t bytes, size_t& mappedBytes) {
+    const AllocatorConfig& config = allocatorConfig();
+    size_t length = roundToHugePages(bytes);
+
+    // Over-map by one huge page and trim, so the region starts on a 2 MB boundary
+    void* raw = mmap(nullptr, length + hugePage, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(raw == MAP_FAILED) {
+        return nullptr;
+    }
+    uintptr_t start = reinterpret_cast<uintptr_t>(raw);
+    uintptr_t aligned = (start + hugePage - 1) & ~(hugePage - 1);
+    if(aligned > start) {
+        munmap(raw, aligned - start);
+    }
+    uintptr_t tail = aligned + length;
+    uintptr_t end = start + length + hugePage;
+    if(end > tail) {
+        munmap(reinterpret_cast<void*>(tail), end - tail);
+    }
+    void* region = reinterpret_cast<void*>(aligned);
+
+#ifdef MADV_HUGEPAGE
+    madvise(region, length, MADV_HUGEPAGE);
+#endif
+
+    if(config.numaNode >= 0) {
+        // mbind straight through the syscall so we don't need libnuma at link time
+        constexpr int mpolBind = 2;
+        unsigned long nodeMask[16]{};
+        constexpr unsigned long maxNode = sizeof(nodeMask) * 8;
+        if(static_cast<unsigned long>(config.numaNode) < maxNode) {
+            nodeMask[config.numaNode / 64] |= 1UL << (config.numaNode % 64);
+            if(syscall(SYS_mbind, region, length, mpolBind, nodeMask, maxNode, 0) != 0) {
+                std::cerr << "[C++] mbind to NUMA node " << config.numaNode << " failed\n";
+            }
+        }
+    }
+
+    // Populate after the advice, otherwise MAP_POPULATE faults everything in as 4 KB pages
+    if(config.populate) {
+#ifdef MADV_POPULATE_WRITE
+        if(madvise(region, length, MADV_POPULATE_WRITE) != 0)
+#endif
+        {
+            volatile unsigned char* bytesPtr = static_cast<unsigned char*>(region);
+            for(size_t off = 0; off < length; off += 4096)
+                bytesPtr[off] = 0;
+        }
+    }
+
+    mappedBytes = length;
+    return region;
+}
+#endif
+} // namespace
+
+AllocatorConfig& allocatorConfig() {
+    static AllocatorConfig config;
+    return config;
+}
+
+size_t reservedBytesFor(size_t bytes) {
+#ifdef OPTIC_HAVE_MMAP_BACKEND
+    if(useMmapBackend(bytes)) {
+        return roundToHugePages(bytes);
+    }
+#endif
+    return bytes;
+}
+
+void* allocateRaw(size_t bytes, BufferDeleter& deleter) {
+    void* ptr{nullptr};
+    deleter.backing = BufferDeleter::Backing::ALIGNED_HEAP;
+    deleter.reservedBytes = bytes;
+#ifdef OPTIC_HAVE_MMAP_BACKEND
+    if(useMmapBackend(bytes)) {
+        size_t mappedBytes{0};
+        if((ptr = mapHugeRegion(bytes, mappedBytes))) {
+            deleter.backing = BufferDeleter::Backing::MMAP;
+            deleter.reservedBytes = mappedBytes;
+        }
+    }
+#endif
+    if(!ptr) {
+        ptr = ::operator new[](bytes, std::align_val_t{cacheLine});
+    }
+    if(deleter.accountant) {
+        deleter.accountant->add(deleter.bufferClass, deleter.reservedBytes);
+    }
+    return ptr;
+}
+
+void BufferDeleter::operator()(void* ptr) const {
+    if(!ptr) {
+        return;
+    }
+    if(accountant) {
+        accountant->release(bufferClass, reservedBytes);
+    }
+    switch(backing) {
+    case Backing::MALLOC:
+        std::free(ptr);
+        break;
+    case Backing::MMAP:
+#ifdef OPTIC_HAVE_MMAP_BACKEND
+        munmap(ptr, reservedBytes);
+#endif
+        break;
+    case Backing::ALIGNED_HEAP:
+        ::operator delete[](ptr, std::align_val_t{cacheLine});
+        break;
+    }
+}
@@ -0,0 +1,56 @@
+#ifndef BUFFER_ALLOCATOR_H
+#define BUFFER_ALLOCATOR_H
+
+#include "MemoryAccounting.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+// Process-wide knobs for the large-buffer backend.
+// Anything at or above hugePageThreshold bytes is mmap'd on a 2 MB boundary and advised
+// MADV_HUGEPAGE (Linux only, everything else falls back to the aligned heap path).
+struct AllocatorConfig {
+    size_t hugePageThreshold = size_t{32} << 20; // 0 disables the mmap backend
+    bool populate = false;                      // pre-fault the mapping up front
+    int numaNode = -1;                          // bind the mapping to one node, -1 = no policy
+};
+AllocatorConfig& allocatorConfig();
+
+struct BufferDeleter {
+    enum class Backing : uint8_t { ALIGNED_HEAP, MMAP, MALLOC };
+    Backing backing{Backing::ALIGNED_HEAP};
+    size_t reservedBytes{0};
+
+    // Optional accounting, released together with the memory
+    MemoryAccountant* accountant{nullptr};
+    BufferClass bufferClass{BufferClass::SCRATCH};
+
+    void operator()(void* ptr) const;
+};
+
+template <typename T> using Buffer = std::unique_ptr<T[], BufferDeleter>;
+
+void* allocateRaw(size_t bytes, BufferDeleter& deleter);
+// What a request of `bytes` really reserves (mmap rounds up to whole huge pages)
+size_t reservedBytesFor(size_t bytes);
+
+// Uninitialised storage, same contract as std::make_unique_for_overwrite<T[]>
+template <typename T>
+Buffer<T> allocateBuffer(size_t count, MemoryAccountant* accountant = nullptr,
+                         BufferClass bufferClass = BufferClass::SCRATCH) {
+    BufferDeleter deleter{.accountant = accountant, .bufferClass = bufferClass};
+    void* ptr = allocateRaw(count * sizeof(T), deleter);
+    return Buffer<T>(static_cast<T*>(ptr), deleter);
+}
+
+// Takes ownership of memory from a C library that hands out malloc'd blocks (stb_image)
+template <typename T>
+Buffer<T> adoptMalloc(T* ptr, size_t bytes, MemoryAccountant* accountant = nullptr,
+                      BufferClass bufferClass = BufferClass::SCRATCH) {
+    BufferDeleter deleter{BufferDeleter::Backing::MALLOC, bytes, accountant, bufferClass};
+    if(ptr && accountant) {
+        accountant->add(bufferClass, bytes);
+    }
+    return Buffer<T>(ptr, deleter);
+}
+#endif
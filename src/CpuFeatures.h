@@ -0,0 +1,24 @@
+#ifndef CPU_FEATURES_H
+#define CPU_FEATURES_H
+
+// Runtime dispatch for the few SIMD kernels that need more than the build's baseline ISA.
+// On x86 (GCC / Clang) such a kernel is compiled with __attribute__((target(...))) so it
+// exists whatever -m flags the build uses, and is only called once the CPU reports the
+// extension. Elsewhere OPTIC_X86_DISPATCH stays undefined and the scalar code runs.
+#if(defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define OPTIC_X86_DISPATCH 1
+#define OPTIC_TARGET_SSSE3 __attribute__((target("ssse3")))
+
+inline bool cpuHasSsse3() {
+#ifdef __SSSE3__
+    return true;
+#else
+    static const bool supported = [] {
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("ssse3") != 0;
+    }();
+    return supported;
+#endif
+}
+#endif
+#endif
@@ -0,0 +1,81 @@
+#ifndef EPILOGUE_H
+#define EPILOGUE_H
+
+#include "Pixel.h"
+#include <algorithm>
+#include <array>
+#include <cstdint>
+
+// A run of pointwise operations folded into one per-pixel step:
+// lookup table -> optional 3x3 channel mix -> lookup table, on RGB (alpha untouched).
+// Any chain of threshold / invert / gamma / grayscale / mix that has at most one mix in it
+// collapses into a single Epilogue, which can run as its own pass or be called from a
+// convolution's resolve step so the filtered pixel is finished before it is stored.
+struct Epilogue {
+    std::array<uint8_t, 256> preLut{};
+    std::array<uint8_t, 256> postLut{};
+    bool hasMix{false};
+    // Row-major RGB matrix in 16.16 fixed point
+    std::array<int32_t, 9> mix{};
+    // Largest |weight| a mix takes; the fixed-point form has room for far more, this just
+    // keeps user input well inside it
+    static constexpr float maxMixWeight = 256.0f;
+
+    Epilogue() { reset(); }
+
+    void reset() {
+        for(int v{0}; v < 256; v++) {
+            preLut[v] = static_cast<uint8_t>(v);
+            postLut[v] = static_cast<uint8_t>(v);
+        }
+        hasMix = false;
+    }
+
+    bool isIdentity() const {
+        for(int v{0}; v < 256; v++) {
+            if(preLut[v] != v || postLut[v] != v) {
+                return false;
+            }
+        }
+        return !hasMix;
+    }
+
+    // Appends a lookup table behind whatever is already here
+    void appendLut(const std::array<uint8_t, 256>& lut) {
+        auto& target = hasMix ? postLut : preLut;
+        for(int v{0}; v < 256; v++)
+            target[v] = lut[target[v]];
+    }
+
+    // False when there's already a mix: the clamp between two mixes doesn't fold.
+    // Weights are clamped to +-maxMixWeight (the parser rejects anything outside it)
+    bool appendMix(const std::array<float, 9>& matrix) {
+        if(hasMix) {
+            return false;
+        }
+        for(int i{0}; i < 9; i++) {
+            float weight = std::clamp(matrix[i], -maxMixWeight, maxMixWeight);
+            mix[i] = static_cast<int32_t>(weight * 65536.0f + (weight < 0 ? -0.5f : 0.5f));
+        }
+        hasMix = true;
+        return true;
+    }
+
+    inline Pixel apply(Pixel p) const {
+        uint8_t r = preLut[p.r], g = preLut[p.g], b = preLut[p.b];
+        if(hasMix) {
+            auto channel = [&](int row) {
+                // 64-bit: three 2^24-scaled weights times 255 overflow 32 bits
+                int64_t sum = int64_t{mix[3 * row]} * r + int64_t{mix[3 * row + 1]} * g +
+                              int64_t{mix[3 * row + 2]} * b;
+                return static_cast<uint8_t>(std::clamp<int64_t>((sum + 32768) >> 16, 0, 255));
+            };
+            uint8_t mr = channel(0), mg = channel(1), mb = channel(2);
+            r = mr;
+            g = mg;
+            b = mb;
+        }
+        return Pixel{postLut[r], postLut[g], postLut[b], p.a};
+    }
+};
+#endif
@@ -0,0 +1,310 @@
+#include "FilterPipeline.h"
+#include "BufferAllocator.h"
+#include "Filters.h"
+#include "Kernel.h"
+#include "Pixel.h"
+#include "RowBand.h"
+#include "Trace.h"
+#include <algorithm>
+#include <cmath>
+#include <mdspan>
+#include <optional>
+#include <span>
+#include <stdexcept>
+
+namespace {
+using Grid = std::mdspan<Pixel, std::dextents<size_t, 2>>;
+constexpr int rowGrain = 16;
+
+int parseInt(const std::string& token, const std::string& arg, int fallback) {
+    if(arg.empty()) {
+        return fallback;
+    }
+    size_t used{0};
+    int value{0};
+    try {
+        value = std::stoi(arg, &used);
+    } catch(const std::exception&) {
+        used = 0;
+    }
+    if(used != arg.size()) {
+        throw std::invalid_argument("Bad argument in pipeline stage '" + token + "'");
+    }
+    return value;
+}
+
+float parseFloat(const std::string& token, const std::string& arg) {
+    size_t used{0};
+    float value{0.0f};
+    try {
+        value = std::stof(arg, &used);
+    } catch(const std::exception&) {
+        used = 0;
+    }
+    if(used == 0 || used != arg.size()) {
+        throw std::invalid_argument("Bad argument in pipeline stage '" + token + "'");
+    }
+    return value;
+}
+
+int parseKernelSize(const std::string& token, const std::string& arg) {
+    int size = parseInt(token, arg, 3);
+    if(size < 1 || size % 2 == 0) {
+        throw std::invalid_argument("Kernel size must be odd and positive in '" + token + "'");
+    }
+    return size;
+}
+
+// Same edge replication as ImageProcessor::createPadding, into a buffer that outlives the stage
+void padInto(const Grid& image, Grid& padded, int border, ThreadPool& pool) {
+    const int height = static_cast<int>(image.extent(0));
+    const int width = static_cast<int>(image.extent(1));
+    const int paddedWidth = static_cast<int>(padded.extent(1));
+    pool.parallelFor(0, static_cast<int>(padded.extent(0)), rowGrain, [&](int first, int last) {
+        for(int i = first; i < last; i++) {
+            size_t srcRow = std::clamp(i - border, 0, height - 1);
+            for(int j{0}; j < paddedWidth; j++) {
+                padded[i, j] = image[srcRow, std::clamp(j - border, 0, width - 1)];
+            }
+        }
+    });
+}
+} // namespace
+
+bool FilterPipeline::appendPointwise(const std::string& token,
+                                     const std::function<bool(Epilogue&)>& append) {
+    if(stages.empty()) {
+        return false;
+    }
+    PipelineStage& previous = stages.back();
+    if(!append(previous.epilogue)) {
+        return false;
+    }
+    previous.fused += (previous.fused.empty() ? "" : "+") + token;
+    return true;
+}
+
+FilterPipeline FilterPipeline::parse(const std::string& spec, bool fuse) {
+    FilterPipeline pipeline;
+    size_t start{0};
+    while(start <= spec.size()) {
+        size_t bar = spec.find('|', start);
+        std::string token =
+            spec.substr(start, bar == std::string::npos ? std::string::npos : bar - start);
+        start = bar == std::string::npos ? spec.size() + 1 : bar + 1;
+
+        token.erase(0, token.find_first_not_of(" \t"));
+        token.erase(token.find_last_not_of(" \t") + 1);
+        if(token.empty()) {
+            throw std::invalid_argument("Empty stage in pipeline '" + spec + "'");
+        }
+        size_t colon = token.find(':');
+        std::string name = token.substr(0, colon);
+        std::string arg = colon == std::string::npos ? "" : token.substr(colon + 1);
+
+        PipelineStage stage;
+        stage.name = name;
+        if(name == "gaussian" || name == "boxblur") {
+            stage.kind = PipelineStage::Kind::KERNEL;
+            stage.kernelSize = parseKernelSize(token, arg);
+        } else if(name == "sobelx" || name == "sobely") {
+            stage.kind = PipelineStage::Kind::KERNEL;
+            stage.kernelSize = 3;
+        } else if(name == "sat") {
+            stage.kind = PipelineStage::Kind::SAT;
+            stage.kernelSize = parseKernelSize(token, arg);
+        } else if(name == "threshold" || name == "invert" || name == "gamma") {
+            std::array<uint8_t, 256> lut{};
+            if(name == "threshold") {
+                int threshold = std::clamp(parseInt(token, arg, 128), 0, 256);
+                for(int v{0}; v < 256; v++)
+                    lut[v] = v >= threshold ? 255 : 0;
+            } else if(name == "invert") {
+                for(int v{0}; v < 256; v++)
+                    lut[v] = static_cast<uint8_t>(255 - v);
+            } else {
+                float gamma = arg.empty() ? 2.2f : parseFloat(token, arg);
+                if(!(gamma > 0.0f)) {
+                    throw std::invalid_argument("Gamma must be positive in '" + token + "'");
+                }
+                for(int v{0}; v < 256; v++)
+                    lut[v] = static_cast<uint8_t>(
+                        std::lround(255.0f * std::pow(v / 255.0f, 1.0f / gamma)));
+            }
+            if(!fuse || !pipeline.appendPointwise(token, [&](Epilogue& e) {
+                   e.appendLut(lut);
+                   return true;
+               })) {
+                stage.kind = PipelineStage::Kind::POINTWISE;
+                stage.epilogue.appendLut(lut);
+                stage.fused = token;
+                pipeline.stages.push_back(stage);
+            }
+            continue;
+        } else if(name == "grayscale" || name == "mix") {
+            std::array<float, 9> matrix{};
+            if(name == "grayscale") {
+                for(int r{0}; r < 3; r++) {
+                    matrix[3 * r] = 0.299f;
+                    matrix[3 * r + 1] = 0.587f;
+                    matrix[3 * r + 2] = 0.114f;
+                }
+            } else {
+                // mix:rr,rg,rb,gr,gg,gb,br,bg,bb - output channel rows
+                size_t pos{0};
+                for(int i{0}; i < 9; i++) {
+                    size_t comma = arg.find(',', pos);
+                    if((comma == std::string::npos) != (i == 8)) {
+                        throw std::invalid_argument("mix needs 9 weights in '" + token + "'");
+                    }
+                    matrix[i] = parseFloat(token, arg.substr(pos, comma - pos));
+                    // Negated so NaN fails too
+                    if(!(std::abs(matrix[i]) <= Epilogue::maxMixWeight)) {
+                        throw std::invalid_argument("mix weights must lie within +-256 in '" +
+                                                    token + "'");
+                    }
+                    pos = comma + 1;
+                }
+            }
+            if(!fuse || !pipeline.appendPointwise(token, [&](Epilogue& e) {
+                   return e.appendMix(matrix);
+               })) {
+                stage.kind = PipelineStage::Kind::POINTWISE;
+                stage.epilogue.appendMix(matrix);
+                stage.fused = token;
+                pipeline.stages.push_back(stage);
+            }
+            continue;
+        } else {
+            throw std::invalid_argument("Unknown pipeline stage '" + token + "'");
+        }
+        pipeline.stages.push_back(stage);
+    }
+    return pipeline;
+}
+
+std::string FilterPipeline::label(const PipelineStage& stage) {
+    if(stage.kind == PipelineStage::Kind::POINTWISE) {
+        return "map(" + stage.fused + ")";
+    }
+    std::string text = stage.name + ":" + std::to_string(stage.kernelSize);
+    if(!stage.fused.empty()) {
+        text += "+map(" + stage.fused + ")";
+    }
+    return text;
+}
+
+std::string FilterPipeline::describe() const {
+    std::string text;
+    for(const auto& stage : stages) {
+        text += (text.empty() ? "" : " -> ") + label(stage);
+    }
+    return text;
+}
+
+void FilterPipeline::run(uint8_t* rgba, int width, int height, MemoryAccountant* accountant,
+                         ThreadPool& pool, StageTimings* timings) const {
+    Grid image(reinterpret_cast<Pixel*>(rgba), height, width);
+
+    // One padded buffer for the whole run, sized for the widest kernel
+    int maxBorder{-1};
+    for(const auto& stage : stages) {
+        if(stage.kind == PipelineStage::Kind::KERNEL) {
+            maxBorder = std::max(maxBorder, stage.kernelSize / 2);
+        }
+    }
+    Buffer<uint8_t> padded;
+    if(maxBorder >= 0) {
+        size_t paddedPixels =
+            static_cast<size_t>(width + 2 * maxBorder) * (height + 2 * maxBorder);
+        padded = allocateBuffer<uint8_t>(paddedPixels * 4, accountant, BufferClass::PADDED);
+    }
+
+    for(const auto& stage : stages) {
+        std::optional<ScopedTimer> timer;
+        switch(stage.kind) {
+        case PipelineStage::Kind::KERNEL: {
+            int border = stage.kernelSize / 2;
+            Grid paddedGrid(reinterpret_cast<Pixel*>(padded.get()), height + 2 * border,
+                            width + 2 * border);
+            // Re-pads between kernels are timed on their own, apart from the convolution
+            if(timings) {
+                timer.emplace(*timings, "pad");
+            }
+            {
+                OPTIC_TRACE_SCOPE("pipeline pad");
+                padInto(image, paddedGrid, border, pool);
+            }
+            if(timings) {
+                timer.reset();
+                timer.emplace(*timings, label(stage));
+            }
+            OPTIC_TRACE_SCOPE("pipeline kernel");
+            // A fused tail runs inside resolve, so the finished pixel is written once
+            const Epilogue* epilogue = stage.fused.empty() ? nullptr : &stage.epilogue;
+            auto convolve = [&](const auto& kernel) {
+                pool.parallelFor(0, height, rowGrain, [&](int first, int last) {
+                    Grid out = image;
+                    for(int i = first; i < last; i++) {
+                        for(int j{0}; j < width; j++) {
+                            applyKernel(out, paddedGrid, i, j, kernel, epilogue);
+                        }
+                    }
+                });
+            };
+            if(stage.name == "gaussian") {
+                convolve(KernelFactory::GaussianBlur(stage.kernelSize));
+            } else if(stage.name == "boxblur") {
+                convolve(KernelFactory::BoxBlur(stage.kernelSize));
+            } else if(stage.name == "sobelx") {
+                convolve(KernelFactory::SobelX());
+            } else {
+                convolve(KernelFactory::SobelY());
+            }
+            break;
+        }
+        case PipelineStage::Kind::SAT: {
+            if(timings) {
+                timer.emplace(*timings, label(stage));
+            }
+            OPTIC_TRACE_SCOPE("pipeline sat");
+            // Row band rather than a full-frame SAT: no uint32 overflow on big images and
+            // only K rows of scratch. Rows land in place once nothing below needs them.
+            const Epilogue* epilogue = stage.fused.empty() ? nullptr : &stage.epilogue;
+            RowBandFilter band(width, height, stage.kernelSize, "sat",
+                               [&](int rowNum, std::span<const Pixel> row) {
+                                   Pixel* out = &image[rowNum, 0];
+                                   if(!epilogue) {
+                                       std::copy(row.begin(), row.end(), out);
+                                       return;
+                                   }
+                                   for(const Pixel& p : row)
+                                       *out++ = epilogue->apply(p);
+                               });
+            std::optional<MemoryAccountant::Charge> charge;
+            if(accountant) {
+                charge.emplace(*accountant, BufferClass::SCRATCH, band.getBufferBytes());
+            }
+            for(int i{0}; i < height; i++) {
+                band.pushRow(std::span<const Pixel>(&image[i, 0], width));
+            }
+            break;
+        }
+        case PipelineStage::Kind::POINTWISE: {
+            if(timings) {
+                timer.emplace(*timings, label(stage));
+            }
+            OPTIC_TRACE_SCOPE("pipeline pointwise");
+            const Epilogue& epilogue = stage.epilogue;
+            Pixel* pixels = reinterpret_cast<Pixel*>(rgba);
+            pool.parallelFor(0, height, rowGrain, [&](int first, int last) {
+                Pixel* p = pixels + static_cast<size_t>(first) * width;
+                Pixel* end = pixels + static_cast<size_t>(last) * width;
+                for(; p < end; p++)
+                    *p = epilogue.apply(*p);
+            });
+            break;
+        }
+        }
+    }
+}
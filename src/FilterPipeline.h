@@ -0,0 +1,57 @@
+#ifndef FILTER_PIPELINE_H
+#define FILTER_PIPELINE_H
+
+#include "Epilogue.h"
+#include "MemoryAccounting.h"
+#include "StageTimings.h"
+#include "ThreadPool.h"
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+struct PipelineStage {
+    enum class Kind {
+        KERNEL,   // gaussian / boxblur / sobelx / sobely through applyKernel
+        SAT,      // summed-area box blur, run as a row band
+        POINTWISE // epilogue on its own, when there's nothing before it to fuse into
+    };
+    Kind kind{Kind::KERNEL};
+    std::string name;
+    int kernelSize{3};
+    // Pointwise tail run on each output pixel; fused lists the ops folded in, "" = none
+    Epilogue epilogue;
+    std::string fused;
+};
+
+// A filter graph parsed from a spec like "gaussian:5|sobelx|threshold:128".
+// Stages run in order over one RGBA image in place. Neighbourhood stages share a single
+// padded buffer sized for the widest kernel, and split their rows over a thread pool.
+// Pointwise stages (threshold:T, invert, gamma:G, grayscale, mix:9 weights within +-256)
+// are fused at parse time into the epilogue of the stage before them, which applies them as
+// each output pixel is resolved: "gaussian:5|threshold:128" reads and writes the image once.
+// Only a pointwise run at the very start, or a second mix, gets a pass of its own.
+class FilterPipeline {
+  public:
+    // Throws std::invalid_argument on an unknown stage or a bad argument.
+    // fuse = false keeps every stage as its own pass, for comparison.
+    static FilterPipeline parse(const std::string& spec, bool fuse = true);
+
+    const std::vector<PipelineStage>& getStages() const { return stages; }
+    // The fused graph, e.g. "gaussian:5+map(threshold:128) -> sobelx:3+map(grayscale+invert)"
+    std::string describe() const;
+
+    // With timings, each stage (and each re-pad) is recorded under its describe() label
+    void run(uint8_t* rgba, int width, int height, MemoryAccountant* accountant,
+             ThreadPool& pool, StageTimings* timings = nullptr) const;
+
+  private:
+    std::vector<PipelineStage> stages;
+
+    static std::string label(const PipelineStage& stage);
+
+    // Folds a pointwise op into the last stage; false if there is none or it won't fit
+    bool appendPointwise(const std::string& token,
+                         const std::function<bool(Epilogue&)>& append);
+};
+#endif
@@ -0,0 +1,388 @@
+#include "FilterServer.h"
+#include "BoundedQueue.h"
+#include "ImageProcessor.h"
+#include "PngWriter.h"
+#include "PpmWriter.h"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+using Clock = std::chrono::steady_clock;
+
+// Write end of the accept thread's wake pipe; used from the signal handler, so plain fd +
+// flag rather than anything that locks
+volatile sig_atomic_t wakeFd{-1};
+std::atomic<bool> stopping{false};
+
+// Interrupts the accept thread's poll (write() is async-signal-safe)
+void wake() {
+    if(wakeFd >= 0) {
+        [[maybe_unused]] ssize_t written = write(wakeFd, "", 1);
+    }
+}
+
+void requestStop() {
+    stopping = true;
+    wake();
+}
+
+void onSignal(int) { requestStop(); }
+
+bool sendAll(int fd, const std::string& text) {
+    size_t sent{0};
+    while(sent < text.size()) {
+        ssize_t n = send(fd, text.data() + sent, text.size() - sent, MSG_NOSIGNAL);
+        if(n < 0 && errno == EINTR) {
+            continue;
+        }
+        if(n <= 0) {
+            return false;
+        }
+        sent += static_cast<size_t>(n);
+    }
+    return true;
+}
+
+// Splits off `count` whitespace separated words; whatever follows them lands in rest
+bool splitWords(const std::string& line, size_t count, std::vector<std::string>& words,
+                std::string& rest) {
+    size_t pos{0};
+    words.clear();
+    while(words.size() < count) {
+        size_t start = line.find_first_not_of(" \t", pos);
+        if(start == std::string::npos) {
+            return false;
+        }
+        pos = std::min(line.find_first_of(" \t", start), line.size());
+        words.push_back(line.substr(start, pos - start));
+    }
+    size_t start = line.find_first_not_of(" \t", pos);
+    rest = start == std::string::npos ? "" : line.substr(start);
+    rest.erase(rest.find_last_not_of(" \t\r") + 1);
+    return true;
+}
+
+bool parseInt(const std::string& text, int& value) {
+    try {
+        size_t used{0};
+        value = std::stoi(text, &used);
+        return used == text.size();
+    } catch(const std::exception&) {
+        return false;
+    }
+}
+
+// Runs <filter> <size|spec> on whatever the processor has loaded
+std::string runFilter(ImageProcessor& processor, const std::string& filter,
+                      const std::string& argument) {
+    if(filter == "pipeline") {
+        return processor.runPipeline(argument) ? "" : "bad pipeline '" + argument + "'";
+    }
+    if(filter != "gaussian" && filter != "boxblur" && filter != "sobelx" && filter != "sobely" &&
+       filter != "sat") {
+        return "unknown filter '" + filter + "'";
+    }
+    int size{0};
+    if(!parseInt(argument, size) || size < 1 || size % 2 == 0) {
+        return "kernel size must be odd and positive";
+    }
+    return processor.applyFilter(size, filter) ? "" : "filter failed";
+}
+
+std::string handleFile(ImageProcessor& processor, const std::string& line) {
+    std::vector<std::string> words;
+    std::string rest;
+    if(!splitWords(line, 4, words, rest) || rest.empty()) {
+        return "usage: FILE <input> <output> <filter> <size|spec>";
+    }
+    const std::string& output = words[2];
+    if(!processor.loadImageFromFile(words[1])) {
+        return "cannot load " + words[1];
+    }
+    std::string error = runFilter(processor, words[3], rest);
+    if(!error.empty()) {
+        return error;
+    }
+    const uint8_t* data = reinterpret_cast<const uint8_t*>(processor.getPixelDataPtr());
+    bool ok = output.ends_with(".png")
+                  ? writePNG(output, data, processor.getWidth(), processor.getHeight())
+                  : writePPM(output, data, processor.getWidth(), processor.getHeight());
+    return ok ? "" : "cannot write " + output;
+}
+
+std::string handleShm(ImageProcessor& processor, const std::string& line) {
+    std::vector<std::string> words;
+    std::string rest;
+    int width{0};
+    int height{0};
+    if(!splitWords(line, 5, words, rest) || rest.empty() || !parseInt(words[2], width) ||
+       !parseInt(words[3], height) || width <= 0 || height <= 0) {
+        return "usage: SHM <name> <width> <height> <filter> <size|spec>";
+    }
+    int fd = shm_open(words[1].c_str(), O_RDWR, 0);
+    if(fd < 0) {
+        return "cannot open shm " + words[1] + ": " + std::strerror(errno);
+    }
+    size_t bytes = static_cast<size_t>(width) * height * 4;
+    struct stat st{};
+    if(fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < bytes) {
+        close(fd);
+        return "shm " + words[1] + " is smaller than " + std::to_string(bytes) + " bytes";
+    }
+    void* mapping = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if(mapping == MAP_FAILED) {
+        return "cannot map shm " + words[1] + ": " + std::strerror(errno);
+    }
+    uint8_t* rgba = static_cast<uint8_t*>(mapping);
+    std::string error;
+    if(processor.loadRgba(rgba, width, height)) {
+        error = runFilter(processor, words[4], rest);
+        if(error.empty()) {
+            const uint8_t* data = reinterpret_cast<const uint8_t*>(processor.getPixelDataPtr());
+            std::copy(data, data + bytes, rgba);
+        }
+    } else {
+        error = "cannot load shm pixels";
+    }
+    munmap(mapping, bytes);
+    return error;
+}
+
+// One client. Between requests it sits in the accept thread's poll set; a complete line is
+// handed to a worker with the connection and comes back with it once the reply is sent.
+struct Connection {
+    int fd{-1};
+    std::string pending; // bytes received past the last complete line
+    std::string line;    // the request a worker is running
+    bool close{false};   // set by the worker: QUIT, SHUTDOWN or a failed send
+};
+
+// Longest request line accepted before the client is dropped
+constexpr size_t maxLineBytes = size_t{64} << 10;
+
+bool takeLine(Connection& connection) {
+    for(;;) {
+        size_t newline = connection.pending.find('\n');
+        if(newline == std::string::npos) {
+            return false;
+        }
+        connection.line = connection.pending.substr(0, newline);
+        connection.pending.erase(0, newline + 1);
+        if(!connection.line.empty() && connection.line.back() == '\r') {
+            connection.line.pop_back();
+        }
+        if(connection.line.find_first_not_of(" \t") != std::string::npos) {
+            return true;
+        }
+    }
+}
+
+// False when the connection should be closed
+bool serveRequest(Connection& connection, ImageProcessor& processor) {
+    const std::string& line = connection.line;
+    std::string command = line.substr(0, line.find_first_of(" \t"));
+    if(command == "QUIT") {
+        return false;
+    }
+    if(command == "SHUTDOWN") {
+        sendAll(connection.fd, "OK\n");
+        requestStop();
+        return false;
+    }
+    if(command == "PING") {
+        return sendAll(connection.fd, "OK\n");
+    }
+
+    Clock::time_point start = Clock::now();
+    std::string error;
+    if(command == "FILE") {
+        error = handleFile(processor, line);
+    } else if(command == "SHM") {
+        error = handleShm(processor, line);
+    } else {
+        error = "unknown command '" + command + "'";
+    }
+    double ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    std::string reply = error.empty() ? "OK " + std::to_string(processor.getWidth()) + " " +
+                                            std::to_string(processor.getHeight()) + " " +
+                                            std::to_string(ms) + "\n"
+                                      : "ERR " + error + "\n";
+    return sendAll(connection.fd, reply);
+}
+} // namespace
+
+bool runFilterServer(const std::string& socketPath, int workers) {
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if(socketPath.size() >= sizeof(address.sun_path)) {
+        std::cerr << "[C++] Socket path too long: " << socketPath << '\n';
+        return false;
+    }
+    std::memcpy(address.sun_path, socketPath.c_str(), socketPath.size() + 1);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+    if(fd < 0) {
+        std::cerr << "[C++] socket: " << std::strerror(errno) << '\n';
+        return false;
+    }
+    // A stale socket from a previous run would make bind fail
+    unlink(socketPath.c_str());
+    if(bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 ||
+       listen(fd, 64) != 0) {
+        std::cerr << "[C++] Cannot listen on " << socketPath << ": " << std::strerror(errno)
+                  << '\n';
+        close(fd);
+        return false;
+    }
+    int wakePipe[2];
+    if(pipe2(wakePipe, O_CLOEXEC | O_NONBLOCK) != 0) {
+        std::cerr << "[C++] pipe: " << std::strerror(errno) << '\n';
+        close(fd);
+        return false;
+    }
+
+    if(workers <= 0) {
+        workers = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+    }
+    stopping = false;
+    wakeFd = wakePipe[1];
+    std::signal(SIGINT, onSignal);
+    std::signal(SIGTERM, onSignal);
+    std::cout << "[C++] Serving on " << socketPath << " with " << workers << " workers"
+              << std::endl;
+
+    // Requests waiting for a worker. The accept thread stops reading new requests once this
+    // many are in flight, so its push never blocks
+    const size_t maxInFlight = static_cast<size_t>(workers) * 4;
+    BoundedQueue<std::unique_ptr<Connection>> requests(maxInFlight);
+    // Connections whose request is done, picked up by the accept thread after a wake
+    std::mutex returnedLock;
+    std::vector<std::unique_ptr<Connection>> returned;
+    std::vector<std::thread> pool;
+    for(int t{0}; t < workers; t++) {
+        pool.emplace_back([&] {
+            ImageProcessor processor;
+            while(std::optional<std::unique_ptr<Connection>> connection = requests.pop()) {
+                // Queued requests are dropped once a stop is under way
+                (*connection)->close = stopping || !serveRequest(**connection, processor);
+                {
+                    std::lock_guard<std::mutex> lk(returnedLock);
+                    returned.push_back(std::move(*connection));
+                }
+                wake();
+            }
+        });
+    }
+
+    std::vector<std::unique_ptr<Connection>> idle;
+    size_t inFlight{0};
+    auto drop = [](std::unique_ptr<Connection>& connection) {
+        close(connection->fd);
+        connection.reset();
+    };
+    while(!stopping) {
+        {
+            std::lock_guard<std::mutex> lk(returnedLock);
+            for(auto& connection : returned) {
+                inFlight--;
+                if(connection->close) {
+                    drop(connection);
+                } else {
+                    idle.push_back(std::move(connection));
+                }
+            }
+            returned.clear();
+        }
+        // Anything with a whole line buffered goes to the workers, while there's room
+        for(auto& connection : idle) {
+            if(inFlight < maxInFlight && takeLine(*connection)) {
+                inFlight++;
+                requests.push(std::move(connection));
+            }
+        }
+        std::erase(idle, nullptr);
+
+        std::vector<pollfd> watched{{wakePipe[0], POLLIN, 0}, {fd, POLLIN, 0}};
+        if(inFlight < maxInFlight) {
+            for(const auto& connection : idle)
+                watched.push_back({connection->fd, POLLIN, 0});
+        }
+        if(poll(watched.data(), watched.size(), -1) < 0) {
+            if(errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        char drain[64];
+        while(read(wakePipe[0], drain, sizeof(drain)) > 0) {
+        }
+        if(watched[1].revents & POLLIN) {
+            int client = accept4(fd, nullptr, nullptr, SOCK_CLOEXEC);
+            if(client >= 0) {
+                auto connection = std::make_unique<Connection>();
+                connection->fd = client;
+                idle.push_back(std::move(connection));
+            }
+        }
+        // watched[2..] mirrors idle from before the accept
+        for(size_t i{2}; i < watched.size(); i++) {
+            if(!watched[i].revents) {
+                continue;
+            }
+            std::unique_ptr<Connection>& connection = idle[i - 2];
+            char chunk[4096];
+            ssize_t n = recv(connection->fd, chunk, sizeof(chunk), MSG_DONTWAIT);
+            if(n < 0 && (errno == EINTR || errno == EAGAIN)) {
+                continue;
+            }
+            if(n <= 0) {
+                drop(connection);
+                continue;
+            }
+            connection->pending.append(chunk, static_cast<size_t>(n));
+            if(connection->pending.size() > maxLineBytes &&
+               connection->pending.find('\n') == std::string::npos) {
+                sendAll(connection->fd, "ERR request line too long\n");
+                drop(connection);
+            }
+        }
+        std::erase(idle, nullptr);
+    }
+
+    // Requests already running finish and get their reply; idle and queued clients are dropped
+    stopping = true;
+    for(auto& connection : idle)
+        drop(connection);
+    requests.close();
+    for(auto& t : pool)
+        t.join();
+    for(auto& connection : returned)
+        drop(connection);
+    wakeFd = -1;
+    close(wakePipe[0]);
+    close(wakePipe[1]);
+    close(fd);
+    unlink(socketPath.c_str());
+    std::signal(SIGINT, SIG_DFL);
+    std::signal(SIGTERM, SIG_DFL);
+    std::cout << "[C++] Server on " << socketPath << " stopped" << std::endl;
+    return true;
+}
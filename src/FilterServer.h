@@ -0,0 +1,21 @@
+#ifndef FILTER_SERVER_H
+#define FILTER_SERVER_H
+
+#include <string>
+
+// Long-running filter daemon on a Unix domain socket. Small jobs (thumbnails) are dominated
+// by process start-up and cold buffers, so the server keeps `workers` threads alive, each
+// with its own ImageProcessor whose source buffer is reused while the image size repeats,
+// plus the shared thread pool for pipelines.
+//
+// One request per line, one reply line each ("OK <width> <height> <ms>" or "ERR <why>"):
+//   FILE <input> <output> <filter> <size>     output ends in .png -> PNG, else PPM
+//   FILE <input> <output> pipeline <spec>     spec as for --pipeline, may contain spaces
+//   SHM  <name> <width> <height> <filter> <size|spec>
+//                                             RGBA in a POSIX shm object, filtered in place
+//   PING | QUIT (close this connection) | SHUTDOWN (stop the server)
+// Between requests a connection idles in the accept thread's poll set; each complete request
+// line goes to whichever worker is free, so keep-alive clients never hold a worker. Returns
+// false if the socket can't be set up; otherwise runs until SHUTDOWN, SIGINT or SIGTERM.
+bool runFilterServer(const std::string& socketPath, int workers = 0);
+#endif
@@ -1,6 +1,7 @@
 #ifndef FILTERS_H
 #define FILTERS_H
 
+#include "Epilogue.h"
 #include "ImageProcessor.h"
 #include "Kernel.h"
 #include "Pixel.h"
@@ -41,13 +42,17 @@ template <typename T> class ConvolutionState {
                          std::clamp(static_cast<int>(sumB / kernel.normalizationFactor), 0, 255)),
                      255};
     }
+
+    // Resolution with fused pointwise work, finished before the pixel is stored
+    inline Pixel resolve(const Epilogue& epilogue) const { return epilogue.apply(resolve()); }
 };
 } // namespace
 
 template <typename T>
 void applyKernel(std::mdspan<Pixel, std::dextents<size_t, 2>>& inputGrid,
                  const std::mdspan<Pixel, std::dextents<size_t, 2>>& paddedGrid,
-                 size_t inputGridRowNum, size_t inputGridColNum, const Kernel<T>& kernel) {
+                 size_t inputGridRowNum, size_t inputGridColNum, const Kernel<T>& kernel,
+                 const Epilogue* epilogue = nullptr) {
 
     int halfW = kernel.width / 2;
     int halfH = kernel.height / 2;
@@ -63,7 +68,8 @@ void applyKernel(std::mdspan<Pixel, std::dextents<size_t, 2>>& inputGrid,
         }
     }
 
-    inputGrid[inputGridRowNum, inputGridColNum] = state.resolve();
+    inputGrid[inputGridRowNum, inputGridColNum] =
+        epilogue ? state.resolve(*epilogue) : state.resolve();
 }
 void naiveBoxBlur(std::mdspan<Pixel, std::dextents<size_t, 2>>& inputGrid,
                   const std::mdspan<Pixel, std::dextents<size_t, 2>>& paddedGrid,
@@ -1,21 +1,37 @@
 #include "ImageProcessor.h"
+#include "Autotuner.h"
+#include "FilterPipeline.h"
 #include "Filters.h"
 #include "Kernel.h"
+#include "MappedFile.h"
 #include "Pixel.h"
-#include <condition_variable>
+#include "PngWriter.h"
+#include "ProfiledMutex.h"
+#include "RowBand.h"
+#include "ThreadPool.h"
+#include "TiffReader.h"
+#include "Trace.h"
+#include <algorithm>
 #include <cstdint>
 #include <iostream>
 #include <mdspan>
 #include <memory>
+#include <new>
 #include <span>
-#include <thread>
+#include <stdexcept>
+#include <vector>
 
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
 namespace {
+// Tiles for the filter traversal: tall enough that a kernel window's rows are reused,
+// narrow enough that a 16K-wide image still splits into work for every core
+constexpr int traverseTileRows = 32;
+constexpr int traverseTileCols = 1024;
+
 struct WavefrontContext {
-    std::mutex m;
-    std::condition_variable data_cond;
+    profiled_mutex m{"wavefront"};
+    profiled_condition_variable data_cond;
     int maxSafeRowForAcross = 0; // Starts at 0 because row 0 is already done (initialized to 0)
 
     // Context references
@@ -30,17 +46,22 @@ struct WavefrontContext {
 
     // Producer: Vertical Pass (Columns)
     void downCol(int batch_size) {
+        OPTIC_TRACE_SCOPE("downCol");
+        // Running column sums live here rather than being read back from the row above:
+        // acrossRow may already be prefix-summing that row in place
+        std::vector<SatPixel> columnSums(w, SatPixel{0, 0, 0, 0});
         // Start at 1 because row 0 is was already initialized with 0, and will have no accumulation
         for(int r{1}; r < h; r++) {
             for(int c{1}; c < w; c++) {
                 // Column Prefix Sum: Current = Input + Above
-                satGrid[r, c] = paddedGrid[r, c] + satGrid[r - 1, c];
+                columnSums[c] = paddedGrid[r, c] + columnSums[c];
+                satGrid[r, c] = columnSums[c];
             }
 
             // Notify periodically to wake up the horizontal thread
             if(r % batch_size == 0) {
                 {
-                    std::lock_guard<std::mutex> lk(m);
+                    std::lock_guard<profiled_mutex> lk(m);
                     maxSafeRowForAcross = r;
                 }
                 data_cond.notify_one();
@@ -49,7 +70,7 @@ struct WavefrontContext {
 
         // Final notification for any remaining rows
         {
-            std::lock_guard<std::mutex> lk(m);
+            std::lock_guard<profiled_mutex> lk(m);
             maxSafeRowForAcross = h;
         }
         data_cond.notify_one();
@@ -57,6 +78,7 @@ struct WavefrontContext {
     // Consumer: Horizontal Pass (Rows)
 
     void acrossRow() {
+        OPTIC_TRACE_SCOPE("acrossRow");
         int currentRow = 1; // Start at 1, row 0 is dummy/boundary
 
         while(currentRow < h) {
@@ -64,7 +86,8 @@ struct WavefrontContext {
 
             // 1. Wait for work
             {
-                std::unique_lock<std::mutex> lk(m);
+                OPTIC_TRACE_SCOPE("acrossRow wait");
+                std::unique_lock<profiled_mutex> lk(m);
                 data_cond.wait(lk, [&] { return maxSafeRowForAcross >= currentRow; });
                 limit = maxSafeRowForAcross;
             }
@@ -87,30 +110,26 @@ struct TwoPassContext {
     std::mdspan<SatPixel, std::dextents<size_t, 2>> satGrid;
     std::mdspan<Pixel, std::dextents<size_t, 2>> paddedGrid;
     int h, w;
+    int strips;
+    ThreadPool& pool;
     TwoPassContext(std::mdspan<SatPixel, std::dextents<size_t, 2>>& _satGrid,
-                   std::mdspan<Pixel, std::dextents<size_t, 2>>& _paddedGrid, int height, int width)
-        : satGrid(_satGrid), paddedGrid(_paddedGrid), h(height), w(width) {}
+                   std::mdspan<Pixel, std::dextents<size_t, 2>>& _paddedGrid, int height, int width,
+                   int _strips, ThreadPool& _pool)
+        : satGrid(_satGrid), paddedGrid(_paddedGrid), h(height), w(width), strips(_strips),
+          pool(_pool) {}
     void execute() {
         // PASS 1: DOWN COLUMNS
-        // Split width into two halves
-        int midW = w / 2;
-        std::thread t1(&TwoPassContext::downCol, this, 0, midW);
-        std::thread t2(&TwoPassContext::downCol, this, midW, w);
-
-        // Columnar Work barrier
-        t1.join();
-        t2.join();
-        // PASS 2: ACROSS ROWS
-        // Split height into two halves
-        int midH = h / 2;
-        std::thread t3(&TwoPassContext::acrossRow, this, 0, midH);
-        std::thread t4(&TwoPassContext::acrossRow, this, midH, h);
+        // Split width into strips; parallelFor returns once all are done (columnar barrier)
+        pool.parallelFor(0, w, (w + strips - 1) / strips,
+                         [this](int first, int last) { downCol(first, last); });
 
-        // Row-wise Work Barrier
-        t3.join();
-        t4.join();
+        // PASS 2: ACROSS ROWS
+        // Split height into strips (row-wise barrier)
+        pool.parallelFor(0, h, (h + strips - 1) / strips,
+                         [this](int first, int last) { acrossRow(first, last); });
     }
     void downCol(int startCol, int endCol) {
+        OPTIC_TRACE_SCOPE("downCol");
         if(startCol == 0) {
             ++startCol;
         }
@@ -122,6 +141,7 @@ struct TwoPassContext {
         }
     }
     void acrossRow(int startRow, int endRow) {
+        OPTIC_TRACE_SCOPE("acrossRow");
         if(startRow == 0) {
             ++startRow;
         }
@@ -134,9 +154,16 @@ struct TwoPassContext {
     }
 };
 
+// Sink for a quiet processor's progress lines. One per thread, so its error state isn't shared
+std::ostream& discard() {
+    thread_local std::ostream sink(nullptr);
+    return sink;
+}
+
 } // namespace
 
-ImageProcessor::ImageProcessor() : width(0), height(0), channels(0), pixelData(nullptr) {
+ImageProcessor::ImageProcessor()
+    : width(0), height(0), channels(0), pixelData(nullptr), pool(sharedThreadPool()) {
     std::cout << "[C++] ImageProcessor Initialized" << std::endl;
 }
 
@@ -147,10 +174,13 @@ ImageProcessor::~ImageProcessor() {
 ImageProcessor::satDataAndGrid
 ImageProcessor::computeSAT(int newWidth, int newHeight, int borderWidth,
                            std::mdspan<Pixel, std::dextents<size_t, 2>> paddedGrid,
-                           ImageProcessor::SatMethod processingType) {
+                           const SatTuning& tuning) {
 
+    ScopedTimer timer(timings, "sat");
+    OPTIC_TRACE_SCOPE("computeSAT");
     // 1. Allocate and Initialize
-    auto satData = std::make_unique_for_overwrite<uint32_t[]>(4 * newHeight * newWidth);
+    auto satData = allocateBuffer<uint32_t>(4 * static_cast<size_t>(newHeight) * newWidth,
+                                            &memory, BufferClass::SAT);
     std::mdspan satGrid(reinterpret_cast<SatPixel*>(satData.get()), newHeight, newWidth);
 
     // Initialize first row and first column to 0 (Boundary conditions)
@@ -159,8 +189,8 @@ ImageProcessor::computeSAT(int newWidth, int newHeight, int borderWidth,
     for(int i{1}; i < newHeight; i++)
         satGrid[i, 0] = {0, 0, 0, 0};
 
-    if(processingType == ImageProcessor::SatMethod::SERIAL) {
-        std::cout << "Linear SAT Creation\n";
+    if(tuning.method == ImageProcessor::SatMethod::SERIAL) {
+        out() << "Linear SAT Creation\n";
         // Standard SAT formula: I(x,y) + SAT(x-1,y) + SAT(x,y-1) - SAT(x-1,y-1)
         for(int i{1}; i < newHeight; i++) {
             for(int k{1}; k < newWidth; k++) {
@@ -168,35 +198,54 @@ ImageProcessor::computeSAT(int newWidth, int newHeight, int borderWidth,
                                 satGrid[i - 1, k - 1];
             }
         }
-    } else if(processingType == ImageProcessor::SatMethod::WAVEFRONT_PIPELINE) {
-        std::cout << "Parallel Sat Creation (WAVEFRONT)\n";
+    } else if(tuning.method == ImageProcessor::SatMethod::WAVEFRONT_PIPELINE) {
+        out() << "Parallel Sat Creation (WAVEFRONT)\n";
         WavefrontContext ctx(satGrid, paddedGrid, newHeight, newWidth);
 
-        // Launch threads
-        // downCol acts as the Producer (Vertical Pass)
-        std::thread t1([&ctx]() { ctx.downCol(32); });
-
-        // acrossRow acts as the Consumer (Horizontal Pass)
-        std::thread t2([&ctx]() { ctx.acrossRow(); });
-
-        t1.join();
-        t2.join();
-    } else if(processingType == ImageProcessor::SatMethod::TWO_PASS_BARRIER) {
-        std::cout << "Parallel Sat Creation (TWO PASS)\n";
-        TwoPassContext ctx(satGrid, paddedGrid, newHeight, newWidth);
+        // downCol acts as the Producer (Vertical Pass), on a pool worker.
+        // Without workers submit runs it inline, and acrossRow then finds every row ready
+        ThreadPool::TaskGroup producer;
+        pool.submit(producer, [&]() { ctx.downCol(std::max(1, tuning.batchSize)); });
+
+        // acrossRow acts as the Consumer (Horizontal Pass), on this thread
+        ctx.acrossRow();
+        pool.wait(producer);
+    } else if(tuning.method == ImageProcessor::SatMethod::TWO_PASS_BARRIER) {
+        out() << "Parallel Sat Creation (TWO PASS)\n";
+        TwoPassContext ctx(satGrid, paddedGrid, newHeight, newWidth, std::max(1, tuning.threads),
+                           pool);
         ctx.execute();
     }
     return std::make_pair(std::move(satData), satGrid);
 }
 
-bool ImageProcessor::loadImage(std::vector<char> buffer, int size) {
-    std::vector<char> m_buffer = std::move(buffer);
+bool ImageProcessor::loadImage(std::span<const std::byte> encoded) {
+    timings.clear();
+    bool ok{false};
+    {
+        ScopedTimer timer(timings, "decode");
+        OPTIC_TRACE_SCOPE("decode");
+        ok = decodeImage(encoded);
+    }
+    loadStages = timings.size();
+    return ok;
+}
 
-    const unsigned char* m_buffer_ptr = reinterpret_cast<const unsigned char*>(m_buffer.data());
+bool ImageProcessor::decodeImage(std::span<const std::byte> encoded) {
+    const unsigned char* encoded_ptr = reinterpret_cast<const unsigned char*>(encoded.data());
+
+    NetpbmImage netpbm;
+    if(parseNetpbm({encoded_ptr, encoded.size()}, netpbm)) {
+        return loadNetpbm(netpbm);
+    }
 
     int tempC;
 
-    pixelDataU.reset(stbi_load_from_memory(m_buffer_ptr, size, &width, &height, &tempC, 4));
+    uint8_t* decoded = stbi_load_from_memory(encoded_ptr, static_cast<int>(encoded.size()), &width,
+                                             &height, &tempC, 4);
+    pixelDataU = adoptMalloc(decoded, static_cast<size_t>(width) * height * 4, &memory,
+                             BufferClass::SOURCE);
+    pixelData = pixelDataU.get();
 
     if(!pixelDataU) {
         std::cerr << "[C++] Failed to load image." << '\n';
@@ -204,20 +253,161 @@ bool ImageProcessor::loadImage(std::vector<char> buffer, int size) {
     }
     channels = 4;
 
+    out() << "[C++] Loaded Image: " << width << "x" << height << " (RGBA)" << '\n';
+
+    return true;
+}
+
+bool ImageProcessor::loadImage(const std::vector<char>& buffer, int size) {
+    return loadImage(std::as_bytes(std::span(buffer.data(), static_cast<size_t>(size))));
+}
+
+bool ImageProcessor::loadImageFromPtr(uintptr_t ptr, size_t size) {
+    return loadImage(std::span(reinterpret_cast<const std::byte*>(ptr), size));
+}
+
+bool ImageProcessor::loadImageFromFile(const std::string& path) {
+    if(isTiffFile(path)) {
+        return loadTiffWindow(path);
+    }
+    timings.clear();
+    MappedFile file;
+    {
+        ScopedTimer timer(timings, "map");
+        if(!file.open(path)) {
+            return false;
+        }
+    }
+    bool ok{false};
+    {
+        ScopedTimer timer(timings, "decode");
+        OPTIC_TRACE_SCOPE("decode");
+        ok = decodeImage(std::as_bytes(file.bytes()));
+    }
+    loadStages = timings.size();
+    return ok;
+}
+
+bool ImageProcessor::loadNetpbm(const NetpbmImage& image) {
+    pixelDataU = allocateBuffer<uint8_t>(static_cast<size_t>(image.width) * image.height * 4,
+                                         &memory, BufferClass::SOURCE);
+    expandNetpbmToRGBA(image, pixelDataU.get());
+    width = image.width;
+    height = image.height;
+    channels = 4;
+    pixelData = pixelDataU.get();
+
+    out() << "[C++] Loaded Netpbm Image: " << width << "x" << height << " (depth "
+              << image.depth << ", maxval " << image.maxval << ") -> RGBA" << '\n';
+    return true;
+}
+
+bool ImageProcessor::loadRgba(const uint8_t* rgba, int w, int h) {
+    if(!rgba || w <= 0 || h <= 0) {
+        return false;
+    }
+    timings.clear();
+    ScopedTimer timer(timings, "load");
+    size_t bytes = static_cast<size_t>(w) * h * 4;
+    // Same size as last time (a server fed thumbnails): keep the warm buffer
+    if(!pixelDataU || pixelData != pixelDataU.get() ||
+       static_cast<size_t>(width) * height * 4 != bytes) {
+        pixelDataU = allocateBuffer<uint8_t>(bytes, &memory, BufferClass::SOURCE);
+    }
+    std::copy(rgba, rgba + bytes, pixelDataU.get());
+    width = w;
+    height = h;
+    channels = 4;
     pixelData = pixelDataU.get();
+    loadStages = 1;
+    return true;
+}
 
-    std::cout << "[C++] Loaded Image: " << width << "x" << height << " (RGBA)" << '\n';
+bool ImageProcessor::loadTiffWindow(const std::string& path, int x, int y, int w, int h) {
+    TiffReader reader;
+    if(!reader.open(path)) {
+        return false;
+    }
+    const TiffInfo& info = reader.info();
+    if(w <= 0 || h <= 0) {
+        x = 0;
+        y = 0;
+        w = info.width;
+        h = info.height;
+    }
+#ifdef __EMSCRIPTEN__
+    int threads{1};
+#else
+    int threads{0};
+#endif
+    timings.clear();
+    Buffer<uint8_t> window;
+    try {
+        window = allocateBuffer<uint8_t>(static_cast<size_t>(w) * h * 4, &memory,
+                                         BufferClass::SOURCE);
+    } catch(const std::bad_alloc&) {
+        std::cerr << "[C++] Not enough memory for a " << w << "x" << h << " TIFF window" << '\n';
+        return false;
+    }
+    {
+        ScopedTimer timer(timings, "decode");
+        OPTIC_TRACE_SCOPE("decode");
+        if(!reader.readWindow(x, y, w, h, window.get(), threads)) {
+            return false;
+        }
+    }
+    loadStages = timings.size();
+    pixelDataU = std::move(window);
+    width = w;
+    height = h;
+    channels = 4;
+    pixelData = pixelDataU.get();
 
-    m_buffer.clear();
-    m_buffer.shrink_to_fit();
+    out() << "[C++] Loaded TIFF window " << w << "x" << h << "+" << x << "+" << y << " of "
+              << info.width << "x" << info.height << " (" << info.tileWidth << "x"
+              << info.tileHeight << (info.tiled ? " tiles" : " strips") << ", "
+              << reader.getBytesRead() << " bytes read)" << '\n';
+    return true;
+}
 
+bool ImageProcessor::runPipeline(const std::string& spec) {
+    if(!pixelData) {
+        std::cerr << "[C++] Failed to process image." << std::endl;
+        return false;
+    }
+    timings.truncate(loadStages);
+    try {
+        FilterPipeline pipeline = FilterPipeline::parse(spec, pipelineFusion);
+        out() << "\nRUNNING PIPELINE " << pipeline.describe() << std::endl;
+        pipeline.run(pixelData, width, height, &memory, sharedThreadPool(), &timings);
+    } catch(const std::invalid_argument& e) {
+        std::cerr << "[C++] " << e.what() << std::endl;
+        return false;
+    }
     return true;
 }
+
+bool ImageProcessor::savePng(const std::string& path, int level) {
+    if(!pixelData) {
+        return false;
+    }
+    ScopedTimer timer(timings, "write");
+    OPTIC_TRACE_SCOPE("write png");
+    return writePNG(path, pixelData, width, height, level);
+}
+
+std::string ImageProcessor::getLastTimings() const { return timings.toJson(); }
+
+StageTimings& ImageProcessor::getTimings() { return timings; }
+
 ImageProcessor::paddedDataAndGrid
 ImageProcessor::createPadding(int newWidth, int newHeight, int borderWidth,
                               std::mdspan<Pixel, std::dextents<size_t, 2>> inputGrid) {
 
-    auto paddedData = std::make_unique_for_overwrite<unsigned char[]>(newWidth * newHeight * 4);
+    ScopedTimer timer(timings, "pad");
+    OPTIC_TRACE_SCOPE("pad");
+    auto paddedData = allocateBuffer<unsigned char>(static_cast<size_t>(newWidth) * newHeight * 4,
+                                                    &memory, BufferClass::PADDED);
     std::mdspan paddedGrid(reinterpret_cast<Pixel*>(paddedData.get()), newHeight, newWidth);
     for(int i{borderWidth}; i < newHeight - borderWidth; i++) {
         for(int k{borderWidth}; k < newWidth - borderWidth; k++) {
@@ -242,9 +432,19 @@ ImageProcessor::createPadding(int newWidth, int newHeight, int borderWidth,
 
     return std::make_pair(std::move(paddedData), paddedGrid);
 }
-void ImageProcessor::applyFilter(int kernelSize, std::string filterType) {
+bool ImageProcessor::applyFilter(int kernelSize, std::string filterType) {
     if(!pixelData) {
         std::cerr << "[C++] Failed to process image." << std::endl;
+        return false;
+    }
+    timings.truncate(loadStages);
+    if(streaming) {
+        return applyFilterStreaming(kernelSize, filterType);
+    }
+    // Sobel is 3x3 whatever size is asked for (as in FilterPipeline); padding for a bigger
+    // kernel would shift its window up and left
+    if(filterType == "sobelx" || filterType == "sobely") {
+        kernelSize = 3;
     }
     // kernel size must be odd and a square => (2n+1) x (2n+1)
     bool create_sat{filterType == "sat"};
@@ -258,47 +458,186 @@ void ImageProcessor::applyFilter(int kernelSize, std::string filterType) {
 
     auto [paddedData, paddedGrid] = createPadding(newWidth, newHeight, borderWidth, inputGrid);
 
-    std::cout << "\nInput Pix[0,0]:\t" << (int)inputGrid[0, 0].r << " " << (int)inputGrid[0, 0].g
+    out() << "\nInput Pix[0,0]:\t" << (int)inputGrid[0, 0].r << " " << (int)inputGrid[0, 0].g
               << " " << (int)inputGrid[0, 0].b << "\n";
 
-    // For iterating through the cells of input grid
+    // For iterating through the cells of input grid, a tile per pool task. Each cell only
+    // writes itself and reads the padded copy or the SAT, so tiles are independent
     auto traverse = [&](auto operation) {
-        for(int i = 0; i < height; i++) {
-            for(int j = 0; j < width; j++) {
-                operation(i, j);
-            }
-        }
+        ScopedTimer timer(timings, "filter");
+        OPTIC_TRACE_SCOPE("filter");
+        pool.parallelFor2D(0, height, 0, width, traverseTileRows, traverseTileCols,
+                           [&](const ThreadPool::Tile& tile) {
+                               for(int i = tile.rowBegin; i < tile.rowEnd; i++) {
+                                   for(int j = tile.colBegin; j < tile.colEnd; j++) {
+                                       operation(i, j);
+                                   }
+                               }
+                           });
     };
 
     if(filterType == "sat") {
-        auto [satData, satGrid] = computeSAT(newWidth, newHeight, borderWidth, paddedGrid,
-                                             ImageProcessor::SatMethod::TWO_PASS_BARRIER);
-        std::cout << "\nRUNNING SAT BOX BLUR" << std::endl;
+        auto [satData, satGrid] =
+            computeSAT(newWidth, newHeight, borderWidth, paddedGrid,
+                       satAuto ? tunedSat(width, height) : satTuning);
+        out() << "\nRUNNING SAT BOX BLUR" << std::endl;
         traverse([&](int i, int j) { satBoxBlur(inputGrid, satGrid, i, j); });
     } else if(filterType == "boxblur") {
-        std::cout << "\nRunning With Generic Kernel Factory Interface, Applying Box Blur" << std::endl;
+        out() << "\nRunning With Generic Kernel Factory Interface, Applying Box Blur" << std::endl;
         auto kernel = KernelFactory::BoxBlur(kernelSize);
         traverse([&](int i, int j) { applyKernel(inputGrid, paddedGrid, i, j, kernel); });
     } else if(filterType == "sobelx") {
-        std::cout << "\nRunning With Generic Kernel Factory Interface, Applying SobelX" << std::endl;
+        out() << "\nRunning With Generic Kernel Factory Interface, Applying SobelX" << std::endl;
         auto kernel = KernelFactory::SobelX();
         traverse([&](int i, int j) { applyKernel(inputGrid, paddedGrid, i, j, kernel); });
     }
     else if(filterType == "sobely") {
-        std::cout << "\nRunning With Generic Kernel Factory Interface, Applying SobelY" << std::endl;
+        out() << "\nRunning With Generic Kernel Factory Interface, Applying SobelY" << std::endl;
         auto kernel = KernelFactory::SobelY();
         traverse([&](int i, int j) { applyKernel(inputGrid, paddedGrid, i, j, kernel); });
     }else if(filterType == "gaussian") {
-        std::cout << "\nRunning With Generic Kernel Factory Interface, Applying Gaussian" << std::endl;
+        out() << "\nRunning With Generic Kernel Factory Interface, Applying Gaussian" << std::endl;
         auto kernel = KernelFactory::GaussianBlur(kernelSize);
         traverse([&](int i, int j) { applyKernel(inputGrid, paddedGrid, i, j, kernel); });
     }
     
-    std::cout << "\nInput Pix[0,0]:\t" << (int)inputGrid[height / 2, width / 2].r << " "
+    out() << "\nInput Pix[0,0]:\t" << (int)inputGrid[height / 2, width / 2].r << " "
               << (int)inputGrid[height / 2, width / 2].g << " "
               << (int)inputGrid[height / 2, width / 2].b << "\n";
+    return true;
+}
+
+bool ImageProcessor::applyFilterStreaming(int kernelSize, const std::string& filterType) {
+    std::mdspan inputGrid(reinterpret_cast<Pixel*>(pixelData), height, width);
+
+    // Output row i only lands once input rows up to i + K/2 are in the ring,
+    // so writing it back in place never clobbers a row that is still needed
+    try {
+        RowBandFilter band(width, height, kernelSize, filterType,
+                           [&](int rowNum, std::span<const Pixel> row) {
+                               std::copy(row.begin(), row.end(), &inputGrid[rowNum, 0]);
+                           });
+        MemoryAccountant::Charge ringCharge(memory, BufferClass::SCRATCH, band.getBufferBytes());
+        ScopedTimer timer(timings, "filter");
+        OPTIC_TRACE_SCOPE("filter streaming");
+        out() << "\nRUNNING ROW-BAND STREAMING " << filterType << " (ring buffer: "
+                  << band.getBufferBytes() << " bytes)" << std::endl;
+        for(int i{0}; i < height; i++) {
+            band.pushRow(std::span<const Pixel>(&inputGrid[i, 0], width));
+        }
+    } catch(const std::invalid_argument& e) {
+        // Thrown before the first row goes in, so the pixels are still the input's
+        std::cerr << "[C++] " << e.what() << std::endl;
+        return false;
+    }
+    return true;
+}
+
+void ImageProcessor::setStreaming(bool enabled) { streaming = enabled; }
+
+void ImageProcessor::setPipelineFusion(bool enabled) { pipelineFusion = enabled; }
+
+void ImageProcessor::setQuiet(bool enabled) { quiet = enabled; }
+
+std::ostream& ImageProcessor::out() const { return quiet ? discard() : std::cout; }
+
+void ImageProcessor::setSatMethod(SatMethod method) {
+    satTuning.method = method;
+    satAuto = false;
+}
+
+void ImageProcessor::setSatTuning(const SatTuning& tuning) {
+    satTuning = tuning;
+    satAuto = false;
+}
+
+MemoryUsage ImageProcessor::getMemoryUsage() const { return memory.getCurrent(); }
+MemoryUsage ImageProcessor::getPeakMemoryUsage() const { return memory.getPeak(); }
+void ImageProcessor::resetPeakMemoryUsage() { memory.resetPeak(); }
+
+MemoryUsage ImageProcessor::predictPeakMemory(int imageWidth, int imageHeight,
+                                              std::string filterType, int kernelSize) const {
+    MemoryUsage usage;
+    usage.source = static_cast<size_t>(imageWidth) * imageHeight * 4;
+    if(streaming) {
+        usage.scratch = RowBandFilter::predictBufferBytes(imageWidth, kernelSize, filterType);
+    } else {
+        // Mirrors applyFilter: the padded copy is always made, the SAT only for "sat"
+        bool create_sat{filterType == "sat"};
+        int borderWidth = ((kernelSize - 1) / 2) + static_cast<int>(create_sat);
+        size_t paddedPixels =
+            static_cast<size_t>(imageWidth + 2 * borderWidth) * (imageHeight + 2 * borderWidth);
+        usage.padded = reservedBytesFor(paddedPixels * 4);
+        if(create_sat) {
+            usage.sat = reservedBytesFor(paddedPixels * 4 * sizeof(uint32_t));
+        }
+    }
+    usage.total = usage.source + usage.padded + usage.sat + usage.scratch + usage.output;
+    return usage;
+}
+
+size_t ImageProcessor::predictTraffic(int imageWidth, int imageHeight, std::string filterType,
+                                      int kernelSize) const {
+    size_t pixels = static_cast<size_t>(imageWidth) * imageHeight;
+    if(streaming) {
+        // Each row read once into the ring and written back once
+        return pixels * 4 * 2;
+    }
+    bool create_sat{filterType == "sat"};
+    int borderWidth = ((kernelSize - 1) / 2) + static_cast<int>(create_sat);
+    size_t paddedPixels =
+        static_cast<size_t>(imageWidth + 2 * borderWidth) * (imageHeight + 2 * borderWidth);
+    // createPadding: source in, padded copy out
+    size_t bytes = pixels * 4 + paddedPixels * 4;
+    if(!create_sat) {
+        // Convolution: the padded copy read once, the result written over the source
+        return bytes + paddedPixels * 4 + pixels * 4;
+    }
+    SatMethod method = satAuto ? tunedSat(imageWidth, imageHeight).method : satTuning.method;
+    size_t satBytes = paddedPixels * 4 * sizeof(uint32_t);
+    if(method == SatMethod::SERIAL) {
+        // One pass: padded in, SAT out (the row above is still cached)
+        bytes += paddedPixels * 4 + satBytes;
+    } else {
+        // downCol reads padded and writes the SAT, then acrossRow reads and rewrites it
+        bytes += paddedPixels * 4 + 3 * satBytes;
+    }
+    // satBoxBlur: two SAT rows (above and below the window) per output row, result out
+    return bytes + 2 * satBytes + pixels * 4;
 }
 
 int ImageProcessor::getWidth() const { return width; }
 int ImageProcessor::getHeight() const { return height; }
 uintptr_t ImageProcessor::getPixelDataPtr() const { return reinterpret_cast<uintptr_t>(pixelData); }
+
+bool ImageProcessor::buildPyramid(int tileSize) {
+    if(!pixelData) {
+        return false;
+    }
+    pyramid.reset();
+    pyramid = std::make_unique<TilePyramid>(pixelData, width, height, tileSize, &memory);
+    out() << "[C++] Built pyramid: " << pyramid->getLevels() << " levels of "
+              << pyramid->getTileSize() << "px tiles" << '\n';
+    return true;
+}
+
+void ImageProcessor::setPyramidFilter(int kernelSize, std::string filterType) {
+    if(pyramid) {
+        pyramid->setFilter(kernelSize, filterType);
+    }
+}
+
+uintptr_t ImageProcessor::getTile(int level, int tileX, int tileY) {
+    return pyramid ? reinterpret_cast<uintptr_t>(pyramid->getTile(level, tileX, tileY)) : 0;
+}
+
+int ImageProcessor::getPyramidLevels() const { return pyramid ? pyramid->getLevels() : 0; }
+int ImageProcessor::getPyramidTileSize() const { return pyramid ? pyramid->getTileSize() : 0; }
+int ImageProcessor::getPyramidLevelWidth(int level) const {
+    return pyramid && level >= 0 && level < pyramid->getLevels() ? pyramid->getLevelWidth(level)
+                                                                 : 0;
+}
+int ImageProcessor::getPyramidLevelHeight(int level) const {
+    return pyramid && level >= 0 && level < pyramid->getLevels() ? pyramid->getLevelHeight(level)
+                                                                 : 0;
+}
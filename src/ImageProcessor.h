@@ -1,42 +1,139 @@
 
 #ifndef IMAGE_PROCESSOR_H
 #define IMAGE_PROCESSOR_H
+#include "BufferAllocator.h"
+#include "MemoryAccounting.h"
+#include "NetpbmReader.h"
 #include "Pixel.h"
+#include "StageTimings.h"
+#include "TilePyramid.h"
+#include <cstddef>
 #include <cstdint>
+#include <iosfwd>
 #include <mdspan>
+#include <memory>
+#include <span>
 #include <string>
+#include <vector>
+
+class ThreadPool;
 
 class ImageProcessor {
   private:
     int width;
     int height;
     int channels;
-    std::unique_ptr<uint8_t> pixelDataU{};
+    // Declared ahead of every buffer so it outlives their deleters
+    MemoryAccountant memory;
+    Buffer<uint8_t> pixelDataU{};
     unsigned char* pixelData;
     uint32_t* satPixelData;
+    bool streaming{false};
+    bool pipelineFusion{true};
+    // Progress lines go nowhere (errors still reach stderr)
+    bool quiet{false};
+    // Stages of the last load + filter (+ write); the first loadStages came from the load
+    StageTimings timings;
+    size_t loadStages{0};
+    std::unique_ptr<TilePyramid> pyramid;
+    // The process-wide pool: the SAT passes and the filter traversal run on it
+    ThreadPool& pool;
 
+  public:
     enum class SatMethod { SERIAL, WAVEFRONT_PIPELINE, TWO_PASS_BARRIER };
-    
+    // How computeSAT runs: batchSize is the wavefront's rows per hand-off, threads the
+    // two-pass split (each pass cuts the grid into that many strips of pool work)
+    struct SatTuning {
+        SatMethod method{SatMethod::TWO_PASS_BARRIER};
+        int batchSize{32};
+        int threads{2};
+    };
+
+  private:
+    SatTuning satTuning;
+    // Until a method is set by hand, the autotuner's table picks it per image size
+    bool satAuto{true};
+
     using paddedDataAndGrid =
-        std::pair<std::unique_ptr<unsigned char[]>, std::mdspan<Pixel, std::dextents<size_t, 2>>>;
+        std::pair<Buffer<unsigned char>, std::mdspan<Pixel, std::dextents<size_t, 2>>>;
     paddedDataAndGrid createPadding(int newWidth, int newHeight, int borderWidth,
                                     std::mdspan<Pixel, std::dextents<size_t, 2>> inputGrid);
     using satDataAndGrid =
-        std::pair<std::unique_ptr<uint32_t[]>, std::mdspan<SatPixel, std::dextents<size_t, 2>>>;
+        std::pair<Buffer<uint32_t>, std::mdspan<SatPixel, std::dextents<size_t, 2>>>;
     satDataAndGrid computeSAT(int newWidth, int newHeight, int borderWidth,
                               std::mdspan<Pixel, std::dextents<size_t, 2>> paddedGrid,
-                              ImageProcessor::SatMethod processingType=ImageProcessor::SatMethod::SERIAL);
+                              const SatTuning& tuning);
+    bool applyFilterStreaming(int kernelSize, const std::string& filterType);
+    // std::cout, or a sink while quiet
+    std::ostream& out() const;
+    bool decodeImage(std::span<const std::byte> encoded);
 
   public:
     ImageProcessor();
     ~ImageProcessor();
 
-    bool loadImage(std::vector<char> buffer, int size);
+    // Decodes in place from the caller's bytes, nothing is copied before the decoder
+    bool loadImage(std::span<const std::byte> encoded);
+    bool loadImage(const std::vector<char>& buffer, int size);
+    // For the web page: bytes already sitting in the wasm heap (_malloc'd by JS)
+    bool loadImageFromPtr(uintptr_t ptr, size_t size);
+    // mmaps the file and decodes straight out of the mapping
+    bool loadImageFromFile(const std::string& path);
+    // Expands a P5/P6/P7 view straight into the RGBA source buffer, no stb_image round trip
+    bool loadNetpbm(const NetpbmImage& image);
+    // Raw RGBA pixels (e.g. a shared-memory request); the source buffer is reused if the size
+    // hasn't changed
+    bool loadRgba(const uint8_t* rgba, int width, int height);
+    // Tiled TIFF / COG: decodes only the tiles under the window (w or h <= 0 = whole image)
+    bool loadTiffWindow(const std::string& path, int x = 0, int y = 0, int w = 0, int h = 0);
+
+    // False (and the pixels left as they were) when the filter can't run, e.g. an even
+    // kernel in row-band mode
+    bool applyFilter(int kernelSize, std::string filterType);
+    // Chained stages in one call, e.g. "gaussian:5|sobelx|threshold:128" (see FilterPipeline)
+    bool runPipeline(const std::string& spec);
+    // Encodes the current pixels as PNG (zlib level 0-9); on the web this lands in MEMFS
+    bool savePng(const std::string& path, int level);
+    // Row-band mode: filters through a ring of K rows instead of a full padded copy / SAT
+    void setStreaming(bool enabled);
+    // How the "sat" filter builds its summed-area table; either call turns the autotuner off
+    void setSatMethod(SatMethod method);
+    void setSatTuning(const SatTuning& tuning);
+    // Off: every pipeline stage gets its own pass instead of riding in a convolution's resolve
+    void setPipelineFusion(bool enabled);
+    // Mutes this processor's progress output only, e.g. while the autotuner runs it
+    void setQuiet(bool enabled);
 
-    void applyFilter(int kernelSize, std::string filterType);
+    // Per-stage wall-clock ns of the last job as JSON (see StageTimings::toJson)
+    std::string getLastTimings() const;
+    // For callers timing their own stages (the CLI's PPM write)
+    StageTimings& getTimings();
+
+    MemoryUsage getMemoryUsage() const;
+    MemoryUsage getPeakMemoryUsage() const;
+    void resetPeakMemoryUsage();
+    // Peak footprint applyFilter would reach on an image of this size (current mode)
+    MemoryUsage predictPeakMemory(int imageWidth, int imageHeight, std::string filterType,
+                                  int kernelSize) const;
+    // Bytes applyFilter moves to and from memory on an image of this size (current mode):
+    // each buffer counted once per pass that streams over it, STREAM-style (no write-allocate),
+    // with kernel windows and the rows just above assumed to stay in cache
+    size_t predictTraffic(int imageWidth, int imageHeight, std::string filterType,
+                          int kernelSize) const;
 
     int getWidth() const;
     int getHeight() const;
     uintptr_t getPixelDataPtr() const;
+
+    // Snapshot of the current pixels as a tiled mip pyramid for pan/zoom viewers
+    bool buildPyramid(int tileSize);
+    // Filter applied lazily, tile by tile, as getTile asks for them ("none" to clear)
+    void setPyramidFilter(int kernelSize, std::string filterType);
+    // tileSize^2 RGBA pixels, 0 when the tile doesn't exist or no pyramid was built
+    uintptr_t getTile(int level, int tileX, int tileY);
+    int getPyramidLevels() const;
+    int getPyramidTileSize() const;
+    int getPyramidLevelWidth(int level) const;
+    int getPyramidLevelHeight(int level) const;
 };
 #endif
@@ -0,0 +1,161 @@
+#include "IoRing.h"
+
+#ifdef OPTIC_HAVE_IO_URING
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace {
+// The ring indices are shared with the kernel, so every access goes through atomic_ref
+unsigned loadAcquire(unsigned* p) {
+    return std::atomic_ref<unsigned>(*p).load(std::memory_order_acquire);
+}
+void storeRelease(unsigned* p, unsigned v) {
+    std::atomic_ref<unsigned>(*p).store(v, std::memory_order_release);
+}
+} // namespace
+
+IoRing::~IoRing() {
+    if(sqes) {
+        munmap(sqes, sqesBytes);
+    }
+    if(cqRing && cqRing != sqRing) {
+        munmap(cqRing, cqRingBytes);
+    }
+    if(sqRing) {
+        munmap(sqRing, sqRingBytes);
+    }
+    if(ringFd >= 0) {
+        close(ringFd);
+    }
+}
+
+bool IoRing::init(unsigned entries) {
+    io_uring_params params{};
+    int fd = static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+    if(fd < 0) {
+        return false;
+    }
+    ringFd = fd;
+
+    sqRingBytes = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cqRingBytes = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    bool singleMmap = params.features & IORING_FEAT_SINGLE_MMAP;
+    if(singleMmap) {
+        sqRingBytes = cqRingBytes = std::max(sqRingBytes, cqRingBytes);
+    }
+    sqRing = mmap(nullptr, sqRingBytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd,
+                  IORING_OFF_SQ_RING);
+    if(sqRing == MAP_FAILED) {
+        sqRing = nullptr;
+        return false;
+    }
+    if(singleMmap) {
+        cqRing = sqRing;
+    } else {
+        cqRing = mmap(nullptr, cqRingBytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd,
+                      IORING_OFF_CQ_RING);
+        if(cqRing == MAP_FAILED) {
+            cqRing = nullptr;
+            return false;
+        }
+    }
+    sqesBytes = params.sq_entries * sizeof(io_uring_sqe);
+    void* sqeMap = mmap(nullptr, sqesBytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd,
+                        IORING_OFF_SQES);
+    if(sqeMap == MAP_FAILED) {
+        return false;
+    }
+    sqes = static_cast<io_uring_sqe*>(sqeMap);
+
+    auto* sq = static_cast<uint8_t*>(sqRing);
+    auto* cq = static_cast<uint8_t*>(cqRing);
+    sqHead = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+    sqTail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+    sqMask = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+    sqArray = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+    cqHead = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+    cqTail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+    cqMask = reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+    cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+    ready = true;
+    return true;
+}
+
+bool IoRing::queue(uint8_t opcode, int fd, uint64_t addr, unsigned len, uint64_t offset,
+                   uint64_t userData) {
+    unsigned tail = *sqTail;
+    if(tail - loadAcquire(sqHead) > *sqMask) {
+        return false;
+    }
+    unsigned index = tail & *sqMask;
+    io_uring_sqe* sqe = &sqes[index];
+    std::memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = opcode;
+    sqe->fd = fd;
+    sqe->addr = addr;
+    sqe->len = len;
+    sqe->off = offset;
+    sqe->user_data = userData;
+    sqArray[index] = index;
+    storeRelease(sqTail, tail + 1);
+    pending++;
+    return true;
+}
+
+bool IoRing::queueRead(int fd, void* buf, unsigned len, uint64_t offset, uint64_t userData) {
+    return queue(IORING_OP_READ, fd, reinterpret_cast<uint64_t>(buf), len, offset, userData);
+}
+
+bool IoRing::queueWrite(int fd, const void* buf, unsigned len, uint64_t offset,
+                        uint64_t userData) {
+    return queue(IORING_OP_WRITE, fd, reinterpret_cast<uint64_t>(buf), len, offset, userData);
+}
+
+bool IoRing::enter(unsigned minComplete) {
+    for(;;) {
+        long submitted = syscall(__NR_io_uring_enter, ringFd, pending, minComplete,
+                                 minComplete ? IORING_ENTER_GETEVENTS : 0, nullptr, 0);
+        if(submitted >= 0) {
+            pending -= static_cast<unsigned>(submitted);
+            return true;
+        }
+        if(errno != EINTR) {
+            return false;
+        }
+    }
+}
+
+bool IoRing::nextCompletion(uint64_t& userData, int& result, bool wait) {
+    if(pending > 0 && !enter(0)) {
+        return false;
+    }
+    for(;;) {
+        unsigned head = *cqHead;
+        if(head != loadAcquire(cqTail)) {
+            const io_uring_cqe& cqe = cqes[head & *cqMask];
+            userData = cqe.user_data;
+            result = cqe.res;
+            storeRelease(cqHead, head + 1);
+            return true;
+        }
+        if(!wait || !enter(1)) {
+            return false;
+        }
+    }
+}
+
+#else
+
+IoRing::~IoRing() = default;
+bool IoRing::init(unsigned) { return false; }
+bool IoRing::queueRead(int, void*, unsigned, uint64_t, uint64_t) { return false; }
+bool IoRing::queueWrite(int, const void*, unsigned, uint64_t, uint64_t) { return false; }
+bool IoRing::nextCompletion(uint64_t&, int&, bool) { return false; }
+
+#endif
@@ -0,0 +1,62 @@
+#ifndef IO_RING_H
+#define IO_RING_H
+
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__linux__) && !defined(__EMSCRIPTEN__) && __has_include(<linux/io_uring.h>)
+#define OPTIC_HAVE_IO_URING 1
+struct io_uring_sqe;
+struct io_uring_cqe;
+#endif
+
+// Bare io_uring over the raw syscalls (no liburing): one ring, one owning thread.
+// Reads and writes are queued as SQEs and only handed to the kernel by nextCompletion,
+// so a stage can batch up several requests per syscall.
+class IoRing {
+  public:
+    IoRing() = default;
+    ~IoRing();
+    IoRing(const IoRing&) = delete;
+    IoRing& operator=(const IoRing&) = delete;
+
+    // False when io_uring isn't there (old kernel, seccomp, non-Linux); use the fallback
+    bool init(unsigned entries);
+    bool isReady() const { return ready; }
+
+    // False when the submission queue is full
+    bool queueRead(int fd, void* buf, unsigned len, uint64_t offset, uint64_t userData);
+    bool queueWrite(int fd, const void* buf, unsigned len, uint64_t offset, uint64_t userData);
+
+    // Submits anything queued, then takes one completion. result is the byte count or -errno.
+    // Without wait, returns false straight away if nothing has completed yet.
+    bool nextCompletion(uint64_t& userData, int& result, bool wait);
+
+  private:
+    int ringFd{-1};
+    bool ready{false};
+    unsigned pending{0};
+
+#ifdef OPTIC_HAVE_IO_URING
+    void* sqRing{nullptr};
+    size_t sqRingBytes{0};
+    void* cqRing{nullptr};
+    size_t cqRingBytes{0};
+    io_uring_sqe* sqes{nullptr};
+    size_t sqesBytes{0};
+
+    unsigned* sqHead{nullptr};
+    unsigned* sqTail{nullptr};
+    unsigned* sqMask{nullptr};
+    unsigned* sqArray{nullptr};
+    unsigned* cqHead{nullptr};
+    unsigned* cqTail{nullptr};
+    unsigned* cqMask{nullptr};
+    io_uring_cqe* cqes{nullptr};
+
+    bool enter(unsigned minComplete);
+    bool queue(uint8_t opcode, int fd, uint64_t addr, unsigned len, uint64_t offset,
+               uint64_t userData);
+#endif
+};
+#endif
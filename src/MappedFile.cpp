@@ -0,0 +1,60 @@
+#include "MappedFile.h"
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <utility>
+
+MappedFile::~MappedFile() { reset(); }
+
+MappedFile::MappedFile(MappedFile&& other) noexcept
+    : data(std::exchange(other.data, nullptr)), size(std::exchange(other.size, 0)) {}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept {
+    if(this != &other) {
+        reset();
+        data = std::exchange(other.data, nullptr);
+        size = std::exchange(other.size, 0);
+    }
+    return *this;
+}
+
+bool MappedFile::open(const std::string& path) {
+    reset();
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if(fd < 0) {
+        std::cerr << "[C++] Cannot open " << path << ": " << std::strerror(errno) << '\n';
+        return false;
+    }
+    struct stat info{};
+    if(fstat(fd, &info) != 0 || info.st_size == 0) {
+        std::cerr << "[C++] Cannot map empty or unreadable file " << path << '\n';
+        ::close(fd);
+        return false;
+    }
+    size_t length = static_cast<size_t>(info.st_size);
+    void* region = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    // The mapping keeps its own reference to the file
+    ::close(fd);
+    if(region == MAP_FAILED) {
+        std::cerr << "[C++] mmap of " << path << " failed: " << std::strerror(errno) << '\n';
+        return false;
+    }
+#ifdef MADV_SEQUENTIAL
+    madvise(region, length, MADV_SEQUENTIAL);
+#endif
+    data = static_cast<const uint8_t*>(region);
+    size = length;
+    return true;
+}
+
+void MappedFile::reset() {
+    if(data) {
+        munmap(const_cast<uint8_t*>(data), size);
+    }
+    data = nullptr;
+    size = 0;
+}
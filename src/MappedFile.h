@@ -0,0 +1,29 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+
+// Read-only mmap of a whole file. Move-only, unmaps on destruction.
+class MappedFile {
+  public:
+    MappedFile() = default;
+    ~MappedFile();
+    MappedFile(MappedFile&& other) noexcept;
+    MappedFile& operator=(MappedFile&& other) noexcept;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool open(const std::string& path);
+    void reset();
+
+    std::span<const uint8_t> bytes() const { return {data, size}; }
+    bool isOpen() const { return data != nullptr; }
+
+  private:
+    const uint8_t* data{nullptr};
+    size_t size{0};
+};
+#endif
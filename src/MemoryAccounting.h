@@ -0,0 +1,93 @@
+#ifndef MEMORY_ACCOUNTING_H
+#define MEMORY_ACCOUNTING_H
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <ostream>
+
+// Buffer classes tracked per ImageProcessor.
+// OUTPUT only counts results held apart from the source; in-place filters report 0 there.
+enum class BufferClass { SOURCE, PADDED, SAT, SCRATCH, OUTPUT, COUNT };
+
+struct MemoryUsage {
+    size_t source{0};
+    size_t padded{0};
+    size_t sat{0};
+    size_t scratch{0};
+    size_t output{0};
+    size_t total{0};
+};
+
+inline std::ostream& operator<<(std::ostream& out, const MemoryUsage& usage) {
+    auto mb = [](size_t bytes) { return static_cast<double>(bytes) / (1024.0 * 1024.0); };
+    return out << "source " << mb(usage.source) << " MB, padded " << mb(usage.padded)
+               << " MB, sat " << mb(usage.sat) << " MB, scratch " << mb(usage.scratch)
+               << " MB, output " << mb(usage.output) << " MB, total " << mb(usage.total) << " MB";
+}
+
+class MemoryAccountant {
+  private:
+    static constexpr size_t classCount = static_cast<size_t>(BufferClass::COUNT);
+    std::array<std::atomic<size_t>, classCount> current{};
+    std::array<std::atomic<size_t>, classCount> peak{};
+    std::atomic<size_t> currentTotal{0};
+    std::atomic<size_t> peakTotal{0};
+
+    static void raise(std::atomic<size_t>& high, size_t value) {
+        size_t seen = high.load(std::memory_order_relaxed);
+        while(seen < value && !high.compare_exchange_weak(seen, value, std::memory_order_relaxed)) {
+        }
+    }
+
+    static MemoryUsage snapshot(const std::array<std::atomic<size_t>, classCount>& bytes,
+                                size_t total) {
+        MemoryUsage usage;
+        usage.source = bytes[static_cast<size_t>(BufferClass::SOURCE)].load();
+        usage.padded = bytes[static_cast<size_t>(BufferClass::PADDED)].load();
+        usage.sat = bytes[static_cast<size_t>(BufferClass::SAT)].load();
+        usage.scratch = bytes[static_cast<size_t>(BufferClass::SCRATCH)].load();
+        usage.output = bytes[static_cast<size_t>(BufferClass::OUTPUT)].load();
+        usage.total = total;
+        return usage;
+    }
+
+  public:
+    void add(BufferClass bufferClass, size_t bytes) {
+        size_t index = static_cast<size_t>(bufferClass);
+        raise(peak[index], current[index].fetch_add(bytes) + bytes);
+        raise(peakTotal, currentTotal.fetch_add(bytes) + bytes);
+    }
+    void release(BufferClass bufferClass, size_t bytes) {
+        current[static_cast<size_t>(bufferClass)].fetch_sub(bytes);
+        currentTotal.fetch_sub(bytes);
+    }
+
+    MemoryUsage getCurrent() const { return snapshot(current, currentTotal.load()); }
+    // Per-class fields are each class's own high-water mark, total is the highest
+    // simultaneous footprint
+    MemoryUsage getPeak() const { return snapshot(peak, peakTotal.load()); }
+
+    void resetPeak() {
+        for(size_t i{0}; i < classCount; i++)
+            peak[i] = current[i].load();
+        peakTotal = currentTotal.load();
+    }
+
+    // Charges a buffer the accountant doesn't own (std::vector scratch etc.) for a scope
+    class Charge {
+        MemoryAccountant& accountant;
+        BufferClass bufferClass;
+        size_t bytes;
+
+      public:
+        Charge(MemoryAccountant& _accountant, BufferClass _bufferClass, size_t _bytes)
+            : accountant(_accountant), bufferClass(_bufferClass), bytes(_bytes) {
+            accountant.add(bufferClass, bytes);
+        }
+        ~Charge() { accountant.release(bufferClass, bytes); }
+        Charge(const Charge&) = delete;
+        Charge& operator=(const Charge&) = delete;
+    };
+};
+#endif
@@ -0,0 +1,113 @@
+#ifndef MPMC_QUEUE_H
+#define MPMC_QUEUE_H
+
+#include <atomic>
+#include <concepts>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <optional>
+#include <utility>
+
+// Bounded lock-free multi-producer / multi-consumer FIFO (Dmitry Vyukov's ring).
+// Every slot carries a sequence number that says whose turn it is: a producer may fill
+// slot i at position pos once sequence == pos, a consumer may empty it once
+// sequence == pos + 1. A push or pop is one CAS on the shared position plus one release
+// store on the slot, so there is no lock to convoy on, and pushes and pops contend on
+// different cache lines. tryPush/tryPop never block; callers that want to wait spin or
+// yield around them. Capacity is rounded up to a power of two.
+template <std::movable T> class MpmcQueue {
+  private:
+    static constexpr size_t cacheLine = 64;
+
+    struct alignas(cacheLine) Slot {
+        std::atomic<size_t> sequence;
+        alignas(T) std::byte storage[sizeof(T)];
+
+        T* item() { return std::launder(reinterpret_cast<T*>(storage)); }
+    };
+
+    std::unique_ptr<Slot[]> slots;
+    size_t mask;
+    alignas(cacheLine) std::atomic<size_t> pushPos{0};
+    alignas(cacheLine) std::atomic<size_t> popPos{0};
+
+    static size_t roundUp(size_t n) {
+        size_t capacity{2};
+        while(capacity < n)
+            capacity <<= 1;
+        return capacity;
+    }
+
+  public:
+    explicit MpmcQueue(size_t _capacity)
+        : slots(new Slot[roundUp(_capacity)]), mask(roundUp(_capacity) - 1) {
+        for(size_t i{0}; i <= mask; i++)
+            slots[i].sequence.store(i, std::memory_order_relaxed);
+    }
+
+    ~MpmcQueue() {
+        while(tryPop()) {
+        }
+    }
+
+    MpmcQueue(const MpmcQueue&) = delete;
+    MpmcQueue& operator=(const MpmcQueue&) = delete;
+
+    size_t capacity() const { return mask + 1; }
+
+    // False (and item left untouched) when the queue is full
+    template <typename U = T> bool tryPush(U&& item) {
+        size_t pos = pushPos.load(std::memory_order_relaxed);
+        for(;;) {
+            Slot& slot = slots[pos & mask];
+            size_t sequence = slot.sequence.load(std::memory_order_acquire);
+            auto lag = static_cast<std::ptrdiff_t>(sequence - pos);
+            if(lag == 0) {
+                if(pushPos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    new(slot.storage) T(std::forward<U>(item));
+                    slot.sequence.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if(lag < 0) {
+                // The slot still holds the item from one lap ago: full
+                return false;
+            } else {
+                pos = pushPos.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    bool tryPop(T& out) {
+        std::optional<T> item = tryPop();
+        if(!item) {
+            return false;
+        }
+        out = std::move(*item);
+        return true;
+    }
+
+    // std::nullopt when the queue is empty
+    std::optional<T> tryPop() {
+        size_t pos = popPos.load(std::memory_order_relaxed);
+        for(;;) {
+            Slot& slot = slots[pos & mask];
+            size_t sequence = slot.sequence.load(std::memory_order_acquire);
+            auto lag = static_cast<std::ptrdiff_t>(sequence - (pos + 1));
+            if(lag == 0) {
+                if(popPos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    std::optional<T> item(std::move(*slot.item()));
+                    slot.item()->~T();
+                    // Hand the slot to the producer one lap ahead
+                    slot.sequence.store(pos + mask + 1, std::memory_order_release);
+                    return item;
+                }
+            } else if(lag < 0) {
+                return std::nullopt;
+            } else {
+                pos = popPos.load(std::memory_order_relaxed);
+            }
+        }
+    }
+};
+#endif
@@ -0,0 +1,230 @@
+#include "NetpbmReader.h"
+#include "CpuFeatures.h"
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <iostream>
+#include <string_view>
+
+#ifdef OPTIC_X86_DISPATCH
+#include <tmmintrin.h>
+#endif
+
+namespace {
+struct HeaderCursor {
+    std::span<const uint8_t> bytes;
+    size_t pos{0};
+
+    bool atEnd() const { return pos >= bytes.size(); }
+    static bool isSpace(uint8_t c) {
+        return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\v' || c == '\f';
+    }
+
+    void skipSpaceAndComments() {
+        while(!atEnd()) {
+            if(isSpace(bytes[pos])) {
+                ++pos;
+            } else if(bytes[pos] == '#') {
+                while(!atEnd() && bytes[pos] != '\n')
+                    ++pos;
+            } else {
+                break;
+            }
+        }
+    }
+
+    bool readInt(int& value) {
+        skipSpaceAndComments();
+        size_t start = pos;
+        int64_t parsed{0};
+        while(!atEnd() && bytes[pos] >= '0' && bytes[pos] <= '9') {
+            parsed = parsed * 10 + (bytes[pos] - '0');
+            if(parsed > (int64_t{1} << 30))
+                return false;
+            ++pos;
+        }
+        value = static_cast<int>(parsed);
+        return pos > start;
+    }
+
+    std::string_view readToken() {
+        skipSpaceAndComments();
+        size_t start = pos;
+        while(!atEnd() && !isSpace(bytes[pos]))
+            ++pos;
+        return {reinterpret_cast<const char*>(bytes.data()) + start, pos - start};
+    }
+
+    void skipLine() {
+        while(!atEnd() && bytes[pos] != '\n')
+            ++pos;
+        if(!atEnd())
+            ++pos;
+    }
+};
+
+bool parsePamHeader(HeaderCursor& cursor, NetpbmImage& image) {
+    while(!cursor.atEnd()) {
+        std::string_view keyword = cursor.readToken();
+        if(keyword == "ENDHDR") {
+            cursor.skipLine();
+            return true;
+        } else if(keyword == "WIDTH") {
+            if(!cursor.readInt(image.width))
+                return false;
+        } else if(keyword == "HEIGHT") {
+            if(!cursor.readInt(image.height))
+                return false;
+        } else if(keyword == "DEPTH") {
+            if(!cursor.readInt(image.depth))
+                return false;
+        } else if(keyword == "MAXVAL") {
+            if(!cursor.readInt(image.maxval))
+                return false;
+        } else if(keyword == "TUPLTYPE" || keyword.empty()) {
+            // DEPTH already says how to read the samples
+            cursor.skipLine();
+        } else {
+            return false;
+        }
+    }
+    return false;
+}
+
+// Rescales one sample to 8 bits, clamping values above maxval
+template <int BytesPerSample>
+inline uint8_t loadSample(const uint8_t* sample, int maxval, const std::array<uint8_t, 256>& lut) {
+    if constexpr(BytesPerSample == 1) {
+        return lut[*sample];
+    } else {
+        uint32_t value = std::min<uint32_t>((sample[0] << 8) | sample[1], maxval);
+        return static_cast<uint8_t>((value * 255 + maxval / 2) / maxval);
+    }
+}
+
+template <int BytesPerSample>
+void expandGeneric(const NetpbmImage& image, uint8_t* rgba) {
+    std::array<uint8_t, 256> lut{};
+    if constexpr(BytesPerSample == 1) {
+        for(int v{0}; v < 256; v++)
+            lut[v] = static_cast<uint8_t>((std::min(v, image.maxval) * 255 + image.maxval / 2) /
+                                          image.maxval);
+    }
+    const int step = image.depth * BytesPerSample;
+    for(int r{0}; r < image.height; r++) {
+        const uint8_t* src = image.row(r);
+        uint8_t* dst = rgba + static_cast<size_t>(r) * image.width * 4;
+        for(int c{0}; c < image.width; c++, src += step, dst += 4) {
+            switch(image.depth) {
+            case 1:
+                dst[0] = dst[1] = dst[2] = loadSample<BytesPerSample>(src, image.maxval, lut);
+                dst[3] = 255;
+                break;
+            case 2:
+                dst[0] = dst[1] = dst[2] = loadSample<BytesPerSample>(src, image.maxval, lut);
+                dst[3] = loadSample<BytesPerSample>(src + BytesPerSample, image.maxval, lut);
+                break;
+            default:
+                dst[0] = loadSample<BytesPerSample>(src, image.maxval, lut);
+                dst[1] = loadSample<BytesPerSample>(src + BytesPerSample, image.maxval, lut);
+                dst[2] = loadSample<BytesPerSample>(src + 2 * BytesPerSample, image.maxval, lut);
+                dst[3] = 255;
+                if(image.depth == 4) {
+                    dst[3] =
+                        loadSample<BytesPerSample>(src + 3 * BytesPerSample, image.maxval, lut);
+                }
+                break;
+            }
+        }
+    }
+}
+} // namespace
+
+bool isNetpbm(std::span<const uint8_t> bytes) {
+    return bytes.size() >= 3 && bytes[0] == 'P' &&
+           (bytes[1] == '5' || bytes[1] == '6' || bytes[1] == '7') &&
+           HeaderCursor::isSpace(bytes[2]);
+}
+
+bool parseNetpbm(std::span<const uint8_t> bytes, NetpbmImage& image) {
+    if(!isNetpbm(bytes)) {
+        return false;
+    }
+    image = NetpbmImage{};
+    HeaderCursor cursor{bytes, 2};
+
+    if(bytes[1] == '7') {
+        if(!parsePamHeader(cursor, image))
+            return false;
+    } else {
+        image.depth = bytes[1] == '6' ? 3 : 1;
+        if(!cursor.readInt(image.width) || !cursor.readInt(image.height) ||
+           !cursor.readInt(image.maxval) || cursor.atEnd()) {
+            return false;
+        }
+        // Exactly one whitespace byte separates maxval from the raster
+        if(!HeaderCursor::isSpace(bytes[cursor.pos]))
+            return false;
+        ++cursor.pos;
+    }
+
+    if(image.width <= 0 || image.height <= 0 || image.depth < 1 || image.depth > 4 ||
+       image.maxval < 1 || image.maxval > 65535) {
+        return false;
+    }
+    image.bytesPerSample = image.maxval > 255 ? 2 : 1;
+    image.rowStride = static_cast<size_t>(image.width) * image.depth * image.bytesPerSample;
+    if(image.rowStride * image.height > bytes.size() - cursor.pos) {
+        std::cerr << "[C++] Truncated netpbm raster" << '\n';
+        return false;
+    }
+    image.data = bytes.data() + cursor.pos;
+    return true;
+}
+
+#ifdef OPTIC_X86_DISPATCH
+namespace {
+// pshufb, 4 pixels per shuffle. Each 16-byte load only uses 12 bytes, so keep 6 pixels of
+// source behind it. Returns how many pixels it expanded
+OPTIC_TARGET_SSSE3 size_t expandRGBtoRGBASsse3(const uint8_t* rgb, uint8_t* rgba,
+                                               size_t pixels) {
+    const __m128i spread = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+    const __m128i opaque = _mm_set1_epi32(static_cast<int>(0xFF000000u));
+    size_t i{0};
+    for(; i + 6 <= pixels; i += 4) {
+        __m128i packed = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rgb + 3 * i));
+        __m128i quad = _mm_or_si128(_mm_shuffle_epi8(packed, spread), opaque);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(rgba + 4 * i), quad);
+    }
+    return i;
+}
+} // namespace
+#endif
+
+void expandRGBtoRGBA(const uint8_t* rgb, uint8_t* rgba, size_t pixels) {
+    size_t i{0};
+#ifdef OPTIC_X86_DISPATCH
+    if(cpuHasSsse3()) {
+        i = expandRGBtoRGBASsse3(rgb, rgba, pixels);
+    }
+#endif
+    for(; i < pixels; ++i) {
+        rgba[4 * i] = rgb[3 * i];
+        rgba[4 * i + 1] = rgb[3 * i + 1];
+        rgba[4 * i + 2] = rgb[3 * i + 2];
+        rgba[4 * i + 3] = 255;
+    }
+}
+
+void expandNetpbmToRGBA(const NetpbmImage& image, uint8_t* rgba) {
+    if(image.depth == 3 && image.bytesPerSample == 1 && image.maxval == 255) {
+        // Rows are packed back to back, so the whole raster goes in one call
+        expandRGBtoRGBA(image.data, rgba, static_cast<size_t>(image.width) * image.height);
+    } else if(image.depth == 4 && image.bytesPerSample == 1 && image.maxval == 255) {
+        std::memcpy(rgba, image.data, image.rowStride * image.height);
+    } else if(image.bytesPerSample == 1) {
+        expandGeneric<1>(image, rgba);
+    } else {
+        expandGeneric<2>(image, rgba);
+    }
+}
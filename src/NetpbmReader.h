@@ -0,0 +1,30 @@
+#ifndef NETPBM_READER_H
+#define NETPBM_READER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+// Strided view over the raster of a binary netpbm file (P5 graymap, P6 pixmap, P7 PAM).
+// `data` points into the caller's bytes, nothing is copied. Samples wider than 8 bits
+// (maxval > 255) are two bytes, big-endian, as the format specifies.
+struct NetpbmImage {
+    int width{0};
+    int height{0};
+    int depth{0}; // samples per pixel: 1 gray, 2 gray+alpha, 3 rgb, 4 rgba
+    int maxval{0};
+    int bytesPerSample{1};
+    size_t rowStride{0};
+    const uint8_t* data{nullptr};
+
+    const uint8_t* row(int rowNum) const { return data + rowStride * rowNum; }
+};
+
+bool isNetpbm(std::span<const uint8_t> bytes);
+// Fills `image` from the header; false when the stream is not P5/P6/P7 or is truncated
+bool parseNetpbm(std::span<const uint8_t> bytes, NetpbmImage& image);
+
+// One pass into an 8-bit RGBA frame of width * height * 4 bytes
+void expandNetpbmToRGBA(const NetpbmImage& image, uint8_t* rgba);
+void expandRGBtoRGBA(const uint8_t* rgb, uint8_t* rgba, size_t pixels);
+#endif
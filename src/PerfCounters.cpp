@@ -0,0 +1,150 @@
+#include "PerfCounters.h"
+#include <chrono>
+
+#if defined(__linux__) && !defined(__EMSCRIPTEN__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#define OPTIC_HAVE_PERF_EVENTS 1
+#endif
+
+namespace {
+int64_t nowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+#ifdef OPTIC_HAVE_PERF_EVENTS
+int openCounter(uint32_t type, uint64_t config) {
+    perf_event_attr attr{};
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.disabled = 1;
+    attr.inherit = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    // Lets stop() scale up a count the PMU multiplexed with other events
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+}
+
+constexpr uint64_t cacheMiss(uint64_t cache) {
+    return cache | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+}
+
+// -1 if the counter never ran
+int64_t readCounter(int fd) {
+    uint64_t values[3]{}; // value, time enabled, time running
+    if(read(fd, values, sizeof(values)) != sizeof(values) || values[2] == 0) {
+        return -1;
+    }
+    if(values[2] < values[1]) {
+        return static_cast<int64_t>(static_cast<double>(values[0]) * values[1] / values[2]);
+    }
+    return static_cast<int64_t>(values[0]);
+}
+
+void readFaults(int64_t& minor, int64_t& major) {
+    rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+    minor = usage.ru_minflt;
+    major = usage.ru_majflt;
+}
+#endif
+} // namespace
+
+PerfCounters::PerfCounters() {
+    fds.fill(-1);
+#ifdef OPTIC_HAVE_PERF_EVENTS
+    auto open = [&](Counter counter, uint32_t type, uint64_t config) {
+        fds[static_cast<size_t>(counter)] = openCounter(type, config);
+    };
+    open(Counter::CYCLES, PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+    open(Counter::INSTRUCTIONS, PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+    open(Counter::L1D_MISSES, PERF_TYPE_HW_CACHE, cacheMiss(PERF_COUNT_HW_CACHE_L1D));
+    open(Counter::LLC_MISSES, PERF_TYPE_HW_CACHE, cacheMiss(PERF_COUNT_HW_CACHE_LL));
+    open(Counter::DTLB_MISSES, PERF_TYPE_HW_CACHE, cacheMiss(PERF_COUNT_HW_CACHE_DTLB));
+    open(Counter::BRANCH_MISSES, PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES);
+#endif
+}
+
+PerfCounters::~PerfCounters() {
+#ifdef OPTIC_HAVE_PERF_EVENTS
+    for(int fd : fds) {
+        if(fd >= 0) {
+            close(fd);
+        }
+    }
+#endif
+}
+
+void PerfCounters::start() {
+#ifdef OPTIC_HAVE_PERF_EVENTS
+    readFaults(startMinor, startMajor);
+    for(int fd : fds) {
+        if(fd >= 0) {
+            ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+            ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+        }
+    }
+#endif
+    startNs = nowNs();
+}
+
+PerfCounters::Sample PerfCounters::stop() {
+    Sample sample;
+    sample.wallMs = static_cast<double>(nowNs() - startNs) / 1e6;
+#ifdef OPTIC_HAVE_PERF_EVENTS
+    std::array<int64_t, counterCount> counts;
+    counts.fill(-1);
+    for(size_t i{0}; i < counterCount; i++) {
+        if(fds[i] >= 0) {
+            ioctl(fds[i], PERF_EVENT_IOC_DISABLE, 0);
+            counts[i] = readCounter(fds[i]);
+        }
+    }
+    sample.cycles = counts[static_cast<size_t>(Counter::CYCLES)];
+    sample.instructions = counts[static_cast<size_t>(Counter::INSTRUCTIONS)];
+    sample.l1dMisses = counts[static_cast<size_t>(Counter::L1D_MISSES)];
+    sample.llcMisses = counts[static_cast<size_t>(Counter::LLC_MISSES)];
+    sample.dtlbMisses = counts[static_cast<size_t>(Counter::DTLB_MISSES)];
+    sample.branchMisses = counts[static_cast<size_t>(Counter::BRANCH_MISSES)];
+    int64_t minor{0}, major{0};
+    readFaults(minor, major);
+    sample.minorFaults = minor - startMinor;
+    sample.majorFaults = major - startMajor;
+#endif
+    return sample;
+}
+
+std::ostream& operator<<(std::ostream& out, const PerfCounters::Sample& sample) {
+    auto counter = [&](int64_t value) -> std::ostream& {
+        if(value < 0)
+            return out << "n/a";
+        return out << value;
+    };
+    out << sample.wallMs << " ms, page faults: ";
+    counter(sample.minorFaults) << " minor / ";
+    counter(sample.majorFaults) << " major, dTLB misses: ";
+    counter(sample.dtlbMisses);
+    // The rest only when the PMU is there at all, so VMs without one keep the short line
+    if(sample.cycles < 0 && sample.instructions < 0) {
+        return out;
+    }
+    out << ", cycles: ";
+    counter(sample.cycles) << ", instructions: ";
+    counter(sample.instructions) << ", IPC: ";
+    if(sample.ipc() < 0) {
+        out << "n/a";
+    } else {
+        out << sample.ipc();
+    }
+    out << ", L1d misses: ";
+    counter(sample.l1dMisses) << ", LLC misses: ";
+    counter(sample.llcMisses) << ", branch misses: ";
+    return counter(sample.branchMisses);
+}
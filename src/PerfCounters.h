@@ -0,0 +1,55 @@
+#ifndef PERF_COUNTERS_H
+#define PERF_COUNTERS_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+
+// Page-fault and hardware-counter accounting for a measured region (benchmark mode).
+// Faults come from getrusage, everything else from perf_event_open. Each counter is opened
+// on its own, so one the CPU or kernel refuses (paranoid level, containers, VMs without a
+// PMU, non-Linux) just reads back as -1 while the rest still count. Counters follow the
+// threads started after they were opened, not ones that already existed: open them before
+// the first ImageProcessor, whose constructor starts the shared pool.
+class PerfCounters {
+  public:
+    enum class Counter { CYCLES, INSTRUCTIONS, L1D_MISSES, LLC_MISSES, DTLB_MISSES,
+                         BRANCH_MISSES, COUNT };
+    static constexpr size_t counterCount = static_cast<size_t>(Counter::COUNT);
+
+    struct Sample {
+        double wallMs{0.0};
+        int64_t minorFaults{-1};
+        int64_t majorFaults{-1};
+        int64_t cycles{-1};
+        int64_t instructions{-1};
+        int64_t l1dMisses{-1};
+        int64_t llcMisses{-1};
+        int64_t dtlbMisses{-1};
+        int64_t branchMisses{-1};
+
+        // Instructions per cycle, -1 when either counter is missing
+        double ipc() const {
+            return cycles > 0 && instructions >= 0 ? static_cast<double>(instructions) / cycles
+                                                   : -1.0;
+        }
+    };
+
+    PerfCounters();
+    ~PerfCounters();
+    PerfCounters(const PerfCounters&) = delete;
+    PerfCounters& operator=(const PerfCounters&) = delete;
+
+    void start();
+    Sample stop();
+
+  private:
+    std::array<int, counterCount> fds;
+    int64_t startMinor{0};
+    int64_t startMajor{0};
+    int64_t startNs{0};
+};
+
+std::ostream& operator<<(std::ostream& out, const PerfCounters::Sample& sample);
+#endif
@@ -0,0 +1,336 @@
+#include "PngStreamDecoder.h"
+#include "NetpbmReader.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+namespace {
+constexpr uint8_t pngSignature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+
+uint32_t readBigEndian32(const uint8_t* bytes) {
+    return (uint32_t{bytes[0]} << 24) | (uint32_t{bytes[1]} << 16) | (uint32_t{bytes[2]} << 8) |
+           uint32_t{bytes[3]};
+}
+
+bool isChunk(const std::array<char, 4>& type, const char* name) {
+    return std::memcmp(type.data(), name, 4) == 0;
+}
+
+int samplesFor(uint8_t colorType) {
+    switch(colorType) {
+    case 0: return 1;
+    case 2: return 3;
+    case 3: return 1;
+    case 4: return 2;
+    case 6: return 4;
+    default: return 0;
+    }
+}
+
+// Everything the decoder handles, given IHDR's 13 bytes (interlacing checked separately)
+bool supportedLayout(const uint8_t* ihdr) {
+    uint8_t bitDepth = ihdr[8];
+    uint8_t colorType = ihdr[9];
+    bool lowDepthOk = colorType == 0 || colorType == 3;
+    bool depthOk = bitDepth == 8 || (bitDepth == 16 && colorType != 3) ||
+                   (lowDepthOk && (bitDepth == 1 || bitDepth == 2 || bitDepth == 4));
+    return readBigEndian32(ihdr) != 0 && readBigEndian32(ihdr + 4) != 0 &&
+           samplesFor(colorType) != 0 && depthOk && ihdr[10] == 0 && ihdr[11] == 0;
+}
+} // namespace
+
+bool isPngFile(const std::string& path) {
+    FILE* file = std::fopen(path.c_str(), "rb");
+    if(!file) {
+        return false;
+    }
+    uint8_t signature[8]{};
+    bool match = std::fread(signature, 1, 8, file) == 8 &&
+                 std::memcmp(signature, pngSignature, 8) == 0;
+    std::fclose(file);
+    return match;
+}
+
+bool isStreamablePng(const std::string& path) {
+    FILE* file = std::fopen(path.c_str(), "rb");
+    if(!file) {
+        return false;
+    }
+    // Signature, IHDR length + type, IHDR body
+    uint8_t head[8 + 8 + 13]{};
+    bool ok = std::fread(head, 1, sizeof(head), file) == sizeof(head) &&
+              std::memcmp(head, pngSignature, 8) == 0 && readBigEndian32(head + 8) == 13 &&
+              std::memcmp(head + 12, "IHDR", 4) == 0;
+    std::fclose(file);
+    const uint8_t* ihdr = head + 16;
+    return ok && ihdr[12] == 0 && supportedLayout(ihdr);
+}
+
+PngStreamDecoder::~PngStreamDecoder() {
+    if(inflaterReady) {
+        inflateEnd(&inflater);
+    }
+    if(file) {
+        std::fclose(file);
+    }
+}
+
+bool PngStreamDecoder::readChunkHeader(uint32_t& length, std::array<char, 4>& type) {
+    uint8_t header[8];
+    if(std::fread(header, 1, 8, file) != 8) {
+        return false;
+    }
+    length = readBigEndian32(header);
+    std::memcpy(type.data(), header + 4, 4);
+    return true;
+}
+
+bool PngStreamDecoder::open(const std::string& path) {
+    file = std::fopen(path.c_str(), "rb");
+    if(!file) {
+        std::cerr << "[C++] Cannot open " << path << '\n';
+        return false;
+    }
+    uint8_t signature[8];
+    if(std::fread(signature, 1, 8, file) != 8 || std::memcmp(signature, pngSignature, 8) != 0) {
+        std::cerr << "[C++] " << path << " is not a PNG file" << '\n';
+        return false;
+    }
+
+    uint32_t length{0};
+    std::array<char, 4> type{};
+    uint8_t ihdr[13];
+    if(!readChunkHeader(length, type) || !isChunk(type, "IHDR") || length != 13 ||
+       std::fread(ihdr, 1, 13, file) != 13 || std::fseek(file, 4, SEEK_CUR) != 0) {
+        std::cerr << "[C++] Malformed PNG header" << '\n';
+        return false;
+    }
+    width = readBigEndian32(ihdr);
+    height = readBigEndian32(ihdr + 4);
+    bitDepth = ihdr[8];
+    colorType = ihdr[9];
+    if(ihdr[12] != 0) {
+        std::cerr << "[C++] Interlaced PNGs can't be streamed" << '\n';
+        return false;
+    }
+    samplesPerPixel = samplesFor(colorType);
+    if(!supportedLayout(ihdr)) {
+        std::cerr << "[C++] Unsupported PNG layout" << '\n';
+        return false;
+    }
+    rowBytes = (static_cast<size_t>(width) * samplesPerPixel * bitDepth + 7) / 8;
+    filterStride = std::max<size_t>(1, samplesPerPixel * bitDepth / 8);
+
+    for(int i{0}; i < 256; i++) {
+        palette[4 * i + 3] = 255;
+    }
+
+    // Walk the metadata chunks up to the first IDAT
+    while(true) {
+        if(!readChunkHeader(length, type) || isChunk(type, "IEND")) {
+            std::cerr << "[C++] PNG has no image data" << '\n';
+            return false;
+        }
+        if(isChunk(type, "IDAT")) {
+            idatRemaining = length;
+            break;
+        }
+        if(isChunk(type, "PLTE") || isChunk(type, "tRNS")) {
+            std::vector<uint8_t> body(length);
+            if(std::fread(body.data(), 1, length, file) != length) {
+                return false;
+            }
+            if(isChunk(type, "PLTE")) {
+                for(uint32_t i{0}; i < std::min<uint32_t>(length / 3, 256); i++) {
+                    std::memcpy(&palette[4 * i], &body[3 * i], 3);
+                }
+            } else if(colorType == 3) {
+                for(uint32_t i{0}; i < std::min<uint32_t>(length, 256); i++) {
+                    palette[4 * i + 3] = body[i];
+                }
+            } else if(colorType == 0 && length >= 2) {
+                hasColorKey = true;
+                colorKey[0] = static_cast<uint16_t>((body[0] << 8) | body[1]);
+            } else if(colorType == 2 && length >= 6) {
+                hasColorKey = true;
+                for(int s{0}; s < 3; s++)
+                    colorKey[s] = static_cast<uint16_t>((body[2 * s] << 8) | body[2 * s + 1]);
+            }
+            std::fseek(file, 4, SEEK_CUR);
+        } else {
+            std::fseek(file, static_cast<long>(length) + 4, SEEK_CUR);
+        }
+    }
+
+    if(inflateInit(&inflater) != Z_OK) {
+        return false;
+    }
+    inflaterReady = true;
+    input.resize(inputBlock);
+    prevRow.assign(rowBytes, 0);
+    currRow.resize(rowBytes + 1);
+    return true;
+}
+
+bool PngStreamDecoder::refillInput() {
+    // IDAT data may be split over any number of chunks; CRCs are skipped, zlib's adler32
+    // already covers the payload
+    while(idatRemaining == 0) {
+        uint32_t length{0};
+        std::array<char, 4> type{};
+        if(std::fseek(file, 4, SEEK_CUR) != 0 || !readChunkHeader(length, type) ||
+           !isChunk(type, "IDAT")) {
+            return false;
+        }
+        idatRemaining = length;
+    }
+    size_t want = std::min<size_t>(idatRemaining, input.size());
+    size_t got = std::fread(input.data(), 1, want, file);
+    if(got == 0) {
+        return false;
+    }
+    idatRemaining -= static_cast<uint32_t>(got);
+    inflater.next_in = input.data();
+    inflater.avail_in = static_cast<uInt>(got);
+    return true;
+}
+
+bool PngStreamDecoder::inflateRow() {
+    inflater.next_out = currRow.data();
+    inflater.avail_out = static_cast<uInt>(currRow.size());
+    while(inflater.avail_out > 0) {
+        if(inflater.avail_in == 0 && !refillInput()) {
+            return false;
+        }
+        int status = inflate(&inflater, Z_NO_FLUSH);
+        if(status == Z_STREAM_END) {
+            break;
+        }
+        if(status != Z_OK && status != Z_BUF_ERROR) {
+            std::cerr << "[C++] PNG inflate failed: " << (inflater.msg ? inflater.msg : "?") << '\n';
+            return false;
+        }
+    }
+    return inflater.avail_out == 0;
+}
+
+void PngStreamDecoder::unfilterRow() {
+    uint8_t filter = currRow[0];
+    uint8_t* row = currRow.data() + 1;
+    const uint8_t* up = prevRow.data();
+    size_t bpp = filterStride;
+
+    switch(filter) {
+    case 1:
+        for(size_t i = bpp; i < rowBytes; i++)
+            row[i] += row[i - bpp];
+        break;
+    case 2:
+        for(size_t i{0}; i < rowBytes; i++)
+            row[i] += up[i];
+        break;
+    case 3:
+        for(size_t i{0}; i < rowBytes; i++) {
+            int left = i >= bpp ? row[i - bpp] : 0;
+            row[i] += static_cast<uint8_t>((left + up[i]) / 2);
+        }
+        break;
+    case 4:
+        for(size_t i{0}; i < rowBytes; i++) {
+            int a = i >= bpp ? row[i - bpp] : 0;
+            int b = up[i];
+            int c = i >= bpp ? up[i - bpp] : 0;
+            int p = a + b - c;
+            int pa = std::abs(p - a), pb = std::abs(p - b), pc = std::abs(p - c);
+            row[i] += static_cast<uint8_t>((pa <= pb && pa <= pc) ? a : (pb <= pc ? b : c));
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+uint16_t PngStreamDecoder::sampleAt(const uint8_t* row, size_t index) const {
+    if(bitDepth == 16) {
+        return static_cast<uint16_t>((row[2 * index] << 8) | row[2 * index + 1]);
+    }
+    if(bitDepth == 8) {
+        return row[index];
+    }
+    size_t bit = index * bitDepth;
+    int shift = 8 - bitDepth - static_cast<int>(bit % 8);
+    return static_cast<uint16_t>((row[bit / 8] >> shift) & ((1 << bitDepth) - 1));
+}
+
+void PngStreamDecoder::convertRow(uint8_t* rgba) const {
+    const uint8_t* row = currRow.data() + 1;
+
+    // Common layouts skip the per-sample path entirely
+    if(bitDepth == 8 && colorType == 6) {
+        std::memcpy(rgba, row, rowBytes);
+        return;
+    }
+    if(bitDepth == 8 && colorType == 2 && !hasColorKey) {
+        expandRGBtoRGBA(row, rgba, width);
+        return;
+    }
+
+    auto to8 = [&](uint16_t sample) -> uint8_t {
+        if(bitDepth == 16)
+            return static_cast<uint8_t>(sample >> 8);
+        if(bitDepth < 8)
+            return static_cast<uint8_t>(sample * 255 / ((1 << bitDepth) - 1));
+        return static_cast<uint8_t>(sample);
+    };
+
+    for(uint32_t x{0}; x < width; x++, rgba += 4) {
+        size_t base = static_cast<size_t>(x) * samplesPerPixel;
+        switch(colorType) {
+        case 0: {
+            uint16_t gray = sampleAt(row, base);
+            rgba[0] = rgba[1] = rgba[2] = to8(gray);
+            rgba[3] = (hasColorKey && gray == colorKey[0]) ? 0 : 255;
+            break;
+        }
+        case 2: {
+            uint16_t r = sampleAt(row, base), g = sampleAt(row, base + 1),
+                     b = sampleAt(row, base + 2);
+            rgba[0] = to8(r);
+            rgba[1] = to8(g);
+            rgba[2] = to8(b);
+            rgba[3] = (hasColorKey && r == colorKey[0] && g == colorKey[1] && b == colorKey[2])
+                          ? 0
+                          : 255;
+            break;
+        }
+        case 3:
+            std::memcpy(rgba, &palette[4 * sampleAt(row, base)], 4);
+            break;
+        case 4:
+            rgba[0] = rgba[1] = rgba[2] = to8(sampleAt(row, base));
+            rgba[3] = to8(sampleAt(row, base + 1));
+            break;
+        default:
+            for(int s{0}; s < 4; s++)
+                rgba[s] = to8(sampleAt(row, base + s));
+            break;
+        }
+    }
+}
+
+int PngStreamDecoder::readRows(uint8_t* rgba, int maxRows) {
+    int produced{0};
+    while(produced < maxRows && rowsDone < height) {
+        if(!inflateRow() || currRow[0] > 4) {
+            std::cerr << "[C++] PNG stream ended at row " << rowsDone << " of " << height << '\n';
+            return -1;
+        }
+        unfilterRow();
+        convertRow(rgba + static_cast<size_t>(produced) * width * 4);
+        std::copy(currRow.begin() + 1, currRow.end(), prevRow.begin());
+        rowsDone++;
+        produced++;
+    }
+    return produced;
+}
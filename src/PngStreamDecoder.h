@@ -0,0 +1,69 @@
+#ifndef PNG_STREAM_DECODER_H
+#define PNG_STREAM_DECODER_H
+
+#include <array>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <zlib.h>
+
+bool isPngFile(const std::string& path);
+// A PNG whose IHDR PngStreamDecoder can take: non-interlaced and a supported layout
+bool isStreamablePng(const std::string& path);
+
+// Incremental PNG reader: IDAT chunks are pulled from the file a block at a time,
+// inflated and unfiltered one scanline at a time, and handed out as 8-bit RGBA rows.
+// Memory is two scanlines plus the zlib window, regardless of image height.
+// Non-interlaced images only; 16-bit samples keep their high byte (like stb_image).
+class PngStreamDecoder {
+  public:
+    PngStreamDecoder() = default;
+    ~PngStreamDecoder();
+    PngStreamDecoder(const PngStreamDecoder&) = delete;
+    PngStreamDecoder& operator=(const PngStreamDecoder&) = delete;
+
+    bool open(const std::string& path);
+
+    // Decodes up to maxRows rows into rgba (width * 4 bytes per row).
+    // Returns the rows produced, 0 once the image is done, -1 on a decode error.
+    int readRows(uint8_t* rgba, int maxRows);
+
+    int getWidth() const { return static_cast<int>(width); }
+    int getHeight() const { return static_cast<int>(height); }
+    // Input block plus the two scanlines; zlib's own window comes on top of this
+    size_t getBufferBytes() const { return input.size() + prevRow.size() + currRow.size(); }
+
+  private:
+    static constexpr size_t inputBlock = size_t{64} << 10;
+
+    FILE* file{nullptr};
+    z_stream inflater{};
+    bool inflaterReady{false};
+
+    uint32_t width{0};
+    uint32_t height{0};
+    uint8_t bitDepth{0};
+    uint8_t colorType{0};
+    int samplesPerPixel{0};
+    size_t filterStride{0}; // bytes per complete pixel, at least 1
+    size_t rowBytes{0};
+
+    std::array<uint8_t, 256 * 4> palette{};
+    bool hasColorKey{false};
+    std::array<uint16_t, 3> colorKey{};
+
+    std::vector<uint8_t> input;
+    uint32_t idatRemaining{0};
+    std::vector<uint8_t> prevRow;
+    std::vector<uint8_t> currRow;
+    uint32_t rowsDone{0};
+
+    bool readChunkHeader(uint32_t& length, std::array<char, 4>& type);
+    bool refillInput();
+    bool inflateRow();
+    void unfilterRow();
+    void convertRow(uint8_t* rgba) const;
+    uint16_t sampleAt(const uint8_t* row, size_t index) const;
+};
+#endif
@@ -0,0 +1,278 @@
+#include "PngWriter.h"
+#include "PpmWriter.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <initializer_list>
+#include <iostream>
+#include <span>
+#include <thread>
+#include <unistd.h>
+#include <zlib.h>
+
+namespace {
+constexpr size_t groupTargetBytes = size_t{1} << 20;
+constexpr size_t windowBytes = 32768;
+
+struct Group {
+    std::vector<uint8_t> deflated;
+    uLong adler{1};
+    size_t rawBytes{0};
+    bool ok{false};
+};
+
+class RowFilterer {
+  public:
+    RowFilterer(const uint8_t* _rgba, int _width, int _channels)
+        : rgba(_rgba), width(_width), channels(_channels),
+          rowBytes(static_cast<size_t>(_width) * _channels), prev(rowBytes), curr(rowBytes),
+          candidates(5 * rowBytes) {}
+
+    // Appends the filtered rows [first, last) to out, one filter-type byte + rowBytes each.
+    // Rows only look one row up, so any range can be produced independently.
+    void filterRange(int first, int last, std::vector<uint8_t>& out) {
+        if(first > 0) {
+            extractRow(first - 1, prev.data());
+        }
+        for(int r = first; r < last; r++) {
+            extractRow(r, curr.data());
+            size_t at = out.size();
+            out.resize(at + 1 + rowBytes);
+            filterRow(r > 0 ? prev.data() : nullptr, out.data() + at);
+            std::swap(prev, curr);
+        }
+    }
+
+  private:
+    const uint8_t* rgba;
+    int width;
+    int channels;
+    size_t rowBytes;
+    std::vector<uint8_t> prev;
+    std::vector<uint8_t> curr;
+    std::vector<uint8_t> candidates;
+
+    void extractRow(int r, uint8_t* dst) const {
+        const uint8_t* src = rgba + static_cast<size_t>(r) * width * 4;
+        if(channels == 4) {
+            std::memcpy(dst, src, rowBytes);
+        } else {
+            packRGBAtoRGB(src, dst, width);
+        }
+    }
+
+    // Tries all five filters and keeps the one with the smallest sum of absolute
+    // (signed) residuals, the same heuristic libpng uses
+    void filterRow(const uint8_t* up, uint8_t* dst) {
+        const uint8_t* x = curr.data();
+        const size_t bpp = channels;
+        uint64_t bestCost = UINT64_MAX;
+        int best{0};
+        for(int type{0}; type < 5; type++) {
+            uint8_t* out = candidates.data() + type * rowBytes;
+            uint64_t cost{0};
+            for(size_t i{0}; i < rowBytes; i++) {
+                int a = i >= bpp ? x[i - bpp] : 0;
+                int b = up ? up[i] : 0;
+                int c = up && i >= bpp ? up[i - bpp] : 0;
+                int predicted{0};
+                switch(type) {
+                case 1: predicted = a; break;
+                case 2: predicted = b; break;
+                case 3: predicted = (a + b) / 2; break;
+                case 4: {
+                    int p = a + b - c;
+                    int pa = std::abs(p - a), pb = std::abs(p - b), pc = std::abs(p - c);
+                    predicted = pa <= pb && pa <= pc ? a : (pb <= pc ? b : c);
+                    break;
+                }
+                default: break;
+                }
+                out[i] = static_cast<uint8_t>(x[i] - predicted);
+                cost += static_cast<uint64_t>(std::abs(static_cast<int8_t>(out[i])));
+            }
+            if(cost < bestCost) {
+                bestCost = cost;
+                best = type;
+            }
+        }
+        dst[0] = static_cast<uint8_t>(best);
+        std::memcpy(dst + 1, candidates.data() + best * rowBytes, rowBytes);
+    }
+};
+
+bool deflateGroup(std::span<const uint8_t> raw, std::span<const uint8_t> dictionary, int level,
+                  bool last, std::vector<uint8_t>& out) {
+    z_stream z{};
+    // Raw deflate: the zlib header and Adler-32 trailer are written once for the whole image
+    if(deflateInit2(&z, level, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        return false;
+    }
+    if(!dictionary.empty()) {
+        deflateSetDictionary(&z, dictionary.data(), static_cast<uInt>(dictionary.size()));
+    }
+    out.resize(deflateBound(&z, static_cast<uLong>(raw.size())) + 64);
+    z.next_in = const_cast<Bytef*>(raw.data());
+    z.avail_in = static_cast<uInt>(raw.size());
+    int status{Z_OK};
+    for(;;) {
+        z.next_out = out.data() + z.total_out;
+        z.avail_out = static_cast<uInt>(out.size() - z.total_out);
+        // A sync flush ends byte-aligned without a final block, so the next group can follow
+        status = deflate(&z, last ? Z_FINISH : Z_SYNC_FLUSH);
+        bool done = last ? status == Z_STREAM_END : (status == Z_OK && z.avail_out > 0);
+        if(done || (status != Z_OK && status != Z_BUF_ERROR)) {
+            break;
+        }
+        out.resize(out.size() * 2);
+    }
+    out.resize(z.total_out);
+    deflateEnd(&z);
+    return last ? status == Z_STREAM_END : status == Z_OK;
+}
+
+void appendBE32(std::vector<uint8_t>& out, uint32_t v) {
+    uint8_t bytes[4]{static_cast<uint8_t>(v >> 24), static_cast<uint8_t>(v >> 16),
+                     static_cast<uint8_t>(v >> 8), static_cast<uint8_t>(v)};
+    out.insert(out.end(), bytes, bytes + 4);
+}
+
+void appendChunk(std::vector<uint8_t>& out, const char* type,
+                 std::initializer_list<std::span<const uint8_t>> parts) {
+    size_t length{0};
+    for(const auto& part : parts)
+        length += part.size();
+    appendBE32(out, static_cast<uint32_t>(length));
+    size_t typeAt = out.size();
+    out.insert(out.end(), type, type + 4);
+    for(const auto& part : parts)
+        out.insert(out.end(), part.begin(), part.end());
+    uLong crc = crc32(0, out.data() + typeAt, static_cast<uInt>(out.size() - typeAt));
+    appendBE32(out, static_cast<uint32_t>(crc));
+}
+} // namespace
+
+std::vector<uint8_t> encodePNG(const uint8_t* rgba, int width, int height, int level,
+                               int threads) {
+    level = std::clamp(level, 0, 9);
+    size_t pixels = static_cast<size_t>(width) * height;
+    bool opaque{true};
+    for(size_t i{0}; i < pixels && opaque; i++)
+        opaque = rgba[i * 4 + 3] == 255;
+    const int channels = opaque ? 3 : 4;
+    const size_t filteredRowBytes = static_cast<size_t>(width) * channels + 1;
+
+    const int groupRows =
+        static_cast<int>(std::max<size_t>(1, groupTargetBytes / filteredRowBytes));
+    const int groupCount = (height + groupRows - 1) / groupRows;
+    // Enough rows before a group to fill the 32 KB deflate window
+    const int dictionaryRows =
+        static_cast<int>((windowBytes + filteredRowBytes - 1) / filteredRowBytes);
+    std::vector<Group> groups(groupCount);
+
+#ifdef __EMSCRIPTEN__
+    threads = 1;
+#endif
+    if(threads <= 0) {
+        threads = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+    }
+    threads = std::min(threads, groupCount);
+
+    std::atomic<int> nextGroup{0};
+    auto worker = [&] {
+        RowFilterer filterer(rgba, width, channels);
+        std::vector<uint8_t> filtered;
+        for(int g = nextGroup++; g < groupCount; g = nextGroup++) {
+            int first = g * groupRows;
+            int last = std::min(height, first + groupRows);
+            int primeFrom = std::max(0, first - dictionaryRows);
+            filtered.clear();
+            // The dictionary rows are filtered again here rather than waiting on the
+            // group that owns them, so no group depends on another
+            filterer.filterRange(primeFrom, last, filtered);
+            size_t primeBytes = static_cast<size_t>(first - primeFrom) * filteredRowBytes;
+            std::span<const uint8_t> all(filtered);
+            std::span<const uint8_t> raw = all.subspan(primeBytes);
+            std::span<const uint8_t> dictionary =
+                all.first(primeBytes).last(std::min(primeBytes, windowBytes));
+
+            Group& group = groups[g];
+            group.rawBytes = raw.size();
+            group.adler = adler32(1, raw.data(), static_cast<uInt>(raw.size()));
+            group.ok = deflateGroup(raw, dictionary, level, g == groupCount - 1, group.deflated);
+        }
+    };
+    if(threads <= 1) {
+        worker();
+    } else {
+        std::vector<std::thread> pool;
+        for(int t{0}; t < threads; t++)
+            pool.emplace_back(worker);
+        for(auto& t : pool)
+            t.join();
+    }
+
+    std::vector<uint8_t> png{0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+    std::vector<uint8_t> ihdr;
+    appendBE32(ihdr, static_cast<uint32_t>(width));
+    appendBE32(ihdr, static_cast<uint32_t>(height));
+    ihdr.insert(ihdr.end(), {8, static_cast<uint8_t>(opaque ? 2 : 6), 0, 0, 0});
+    appendChunk(png, "IHDR", {ihdr});
+
+    // zlib header, FLEVEL only advertises the level
+    uint8_t flevel = level < 2 ? 0 : level < 6 ? 1 : level == 6 ? 2 : 3;
+    uint8_t cmf = 0x78;
+    uint8_t flg = static_cast<uint8_t>(flevel << 6);
+    flg = static_cast<uint8_t>(flg + 31 - ((cmf * 256 + flg) % 31));
+    const uint8_t zlibHeader[2]{cmf, flg};
+
+    uLong adler = 1;
+    for(int g{0}; g < groupCount; g++) {
+        const Group& group = groups[g];
+        if(!group.ok) {
+            std::cerr << "[C++] PNG deflate failed for row group " << g << '\n';
+            return {};
+        }
+        adler = adler32_combine(adler, group.adler, static_cast<z_off_t>(group.rawBytes));
+        std::span<const uint8_t> header;
+        if(g == 0) {
+            header = zlibHeader;
+        }
+        std::vector<uint8_t> trailer;
+        if(g == groupCount - 1) {
+            appendBE32(trailer, static_cast<uint32_t>(adler));
+        }
+        appendChunk(png, "IDAT", {header, group.deflated, trailer});
+    }
+    appendChunk(png, "IEND", {});
+    return png;
+}
+
+bool writePNG(const std::string& path, const uint8_t* rgba, int width, int height, int level,
+              int threads) {
+    std::vector<uint8_t> png = encodePNG(rgba, width, height, level, threads);
+    if(png.empty()) {
+        return false;
+    }
+    int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if(fd < 0) {
+        std::cerr << "[C++] Cannot open " << path << " for writing" << '\n';
+        return false;
+    }
+    size_t done{0};
+    while(done < png.size()) {
+        ssize_t put = ::write(fd, png.data() + done, png.size() - done);
+        if(put <= 0) {
+            break;
+        }
+        done += put;
+    }
+    ::close(fd);
+    if(done != png.size()) {
+        std::cerr << "[C++] Short write to " << path << '\n';
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,20 @@
+#ifndef PNG_WRITER_H
+#define PNG_WRITER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// pigz-style parallel PNG encoder. The image is cut into row groups of about a megabyte;
+// every group is filtered and deflated on its own thread as a raw stream (primed with the
+// previous group's last 32 KB as dictionary) and ended on a sync flush, so the pieces
+// concatenate into one zlib stream. Adler-32s are merged with adler32_combine.
+// Writes 8-bit RGB, or RGBA when any pixel isn't opaque. level is zlib's 0-9,
+// threads <= 0 means all cores.
+std::vector<uint8_t> encodePNG(const uint8_t* rgba, int width, int height, int level = 6,
+                               int threads = 0);
+
+bool writePNG(const std::string& path, const uint8_t* rgba, int width, int height,
+              int level = 6, int threads = 0);
+#endif
@@ -0,0 +1,187 @@
+#include "PpmWriter.h"
+#include "CpuFeatures.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <sys/mman.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#ifdef OPTIC_X86_DISPATCH
+#include <tmmintrin.h>
+#endif
+
+namespace {
+// writev until every iovec is drained, picking up after partial writes
+bool writeAll(int fd, iovec* iov, int count) {
+    while(count > 0) {
+        ssize_t written = writev(fd, iov, count);
+        if(written < 0) {
+            if(errno == EINTR)
+                continue;
+            return false;
+        }
+        size_t left = static_cast<size_t>(written);
+        while(count > 0 && left >= iov->iov_len) {
+            left -= iov->iov_len;
+            ++iov;
+            --count;
+        }
+        if(count > 0) {
+            iov->iov_base = static_cast<char*>(iov->iov_base) + left;
+            iov->iov_len -= left;
+        }
+    }
+    return true;
+}
+
+#ifdef OPTIC_X86_DISPATCH
+// pshufb, 4 pixels per shuffle; each 16-byte store leaves 4 junk bytes that the next store
+// overwrites, so stop while there are still 6 pixels of room behind it. Returns how many
+// pixels it packed
+OPTIC_TARGET_SSSE3 size_t packRGBAtoRGBSsse3(const uint8_t* rgba, uint8_t* rgb,
+                                             size_t pixels) {
+    const __m128i dropAlpha = _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+    size_t i{0};
+    for(; i + 6 <= pixels; i += 4) {
+        __m128i quad = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rgba + 4 * i));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(rgb + 3 * i),
+                         _mm_shuffle_epi8(quad, dropAlpha));
+    }
+    return i;
+}
+#endif
+} // namespace
+
+void packRGBAtoRGB(const uint8_t* rgba, uint8_t* rgb, size_t pixels) {
+    size_t i{0};
+#ifdef OPTIC_X86_DISPATCH
+    if(cpuHasSsse3()) {
+        i = packRGBAtoRGBSsse3(rgba, rgb, pixels);
+    }
+#endif
+    // Plain stride-4 to stride-3 copy, which the compilers vectorize on their own
+    for(; i < pixels; ++i) {
+        rgb[3 * i] = rgba[4 * i];
+        rgb[3 * i + 1] = rgba[4 * i + 1];
+        rgb[3 * i + 2] = rgba[4 * i + 2];
+    }
+}
+
+PpmWriter::~PpmWriter() {
+    if(fd >= 0) {
+        close();
+    }
+}
+
+bool PpmWriter::open(const std::string& path, int _width, int _height, PpmOutputMode _mode) {
+    width = _width;
+    height = _height;
+    mode = _mode;
+    rowsWritten = 0;
+    header = "P6\n" + std::to_string(width) + " " + std::to_string(height) + "\n255\n";
+
+    fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if(fd < 0) {
+        std::cerr << "[C++] Cannot open " << path << ": " << std::strerror(errno) << '\n';
+        return false;
+    }
+
+    if(mode == PpmOutputMode::MMAP) {
+        mappingBytes = header.size() + static_cast<size_t>(width) * height * 3;
+        void* region = MAP_FAILED;
+        if(ftruncate(fd, static_cast<off_t>(mappingBytes)) == 0) {
+            region = mmap(nullptr, mappingBytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        }
+        if(region != MAP_FAILED) {
+            mapping = static_cast<uint8_t*>(region);
+            std::memcpy(mapping, header.data(), header.size());
+            mappingCursor = header.size();
+            return true;
+        }
+        std::cerr << "[C++] mmap output unavailable, falling back to buffered writes\n";
+        if(ftruncate(fd, 0) != 0) {
+            return false;
+        }
+        mode = PpmOutputMode::BUFFERED;
+    }
+
+    staging.resize(stagingBytes);
+    headerPending = true;
+    return true;
+}
+
+bool PpmWriter::flushStaging(size_t bytes) {
+    iovec iov[2];
+    int count{0};
+    // The header rides along with the first block instead of costing its own syscall
+    if(headerPending) {
+        iov[count++] = {header.data(), header.size()};
+        headerPending = false;
+    }
+    if(bytes > 0) {
+        iov[count++] = {staging.data(), bytes};
+    }
+    return writeAll(fd, iov, count);
+}
+
+bool PpmWriter::writeRows(const uint8_t* rgba, int rows) {
+    if(fd < 0) {
+        return false;
+    }
+    rows = std::min(rows, height - rowsWritten);
+    size_t pixels = static_cast<size_t>(rows) * width;
+    rowsWritten += rows;
+
+    if(mode == PpmOutputMode::MMAP) {
+        packRGBAtoRGB(rgba, mapping + mappingCursor, pixels);
+        mappingCursor += pixels * 3;
+        return true;
+    }
+
+    size_t pixelsPerBlock = stagingBytes / 3;
+    for(size_t done{0}; done < pixels;) {
+        size_t chunk = std::min(pixelsPerBlock, pixels - done);
+        packRGBAtoRGB(rgba + 4 * done, staging.data(), chunk);
+        if(!flushStaging(chunk * 3)) {
+            std::cerr << "[C++] PPM write failed: " << std::strerror(errno) << '\n';
+            return false;
+        }
+        done += chunk;
+    }
+    return true;
+}
+
+bool PpmWriter::close() {
+    if(fd < 0) {
+        return false;
+    }
+    bool ok{true};
+    if(mode == PpmOutputMode::MMAP) {
+        ok = munmap(mapping, mappingBytes) == 0;
+        mapping = nullptr;
+    } else if(headerPending) {
+        ok = flushStaging(0);
+    }
+    if(rowsWritten != height) {
+        std::cerr << "[C++] PPM closed after " << rowsWritten << " of " << height << " rows\n";
+        ok = false;
+    }
+    ok = (::close(fd) == 0) && ok;
+    fd = -1;
+    staging.clear();
+    staging.shrink_to_fit();
+    return ok;
+}
+
+bool writePPM(const std::string& path, const uint8_t* rgba, int width, int height,
+              PpmOutputMode mode) {
+    PpmWriter writer;
+    if(!writer.open(path, width, height, mode)) {
+        return false;
+    }
+    bool ok = writer.writeRows(rgba, height);
+    return writer.close() && ok;
+}
@@ -0,0 +1,52 @@
+#ifndef PPM_WRITER_H
+#define PPM_WRITER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+enum class PpmOutputMode {
+    BUFFERED, // convert into a reusable staging block, one write/writev per block
+    MMAP      // pre-size the file and convert straight into the mapping
+};
+
+// Drops the alpha byte of every pixel: rgba holds 4 * pixels bytes, rgb receives 3 * pixels
+void packRGBAtoRGB(const uint8_t* rgba, uint8_t* rgb, size_t pixels);
+
+// Binary P6 writer fed with RGBA rows. Rows can be appended incrementally, so the
+// streaming paths can encode a band while the next one is still being filtered.
+class PpmWriter {
+  public:
+    PpmWriter() = default;
+    ~PpmWriter();
+    PpmWriter(const PpmWriter&) = delete;
+    PpmWriter& operator=(const PpmWriter&) = delete;
+
+    bool open(const std::string& path, int width, int height,
+              PpmOutputMode mode = PpmOutputMode::BUFFERED);
+    bool writeRows(const uint8_t* rgba, int rows);
+    bool close();
+
+  private:
+    static constexpr size_t stagingBytes = size_t{1} << 20;
+
+    int fd{-1};
+    int width{0};
+    int height{0};
+    int rowsWritten{0};
+    PpmOutputMode mode{PpmOutputMode::BUFFERED};
+    std::string header;
+    bool headerPending{false};
+    std::vector<uint8_t> staging;
+
+    uint8_t* mapping{nullptr};
+    size_t mappingBytes{0};
+    size_t mappingCursor{0};
+
+    bool flushStaging(size_t bytes);
+};
+
+bool writePPM(const std::string& path, const uint8_t* rgba, int width, int height,
+              PpmOutputMode mode = PpmOutputMode::BUFFERED);
+#endif
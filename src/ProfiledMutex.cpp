@@ -0,0 +1,121 @@
+#include "ProfiledMutex.h"
+#include <iostream>
+
+#ifdef OPTIC_PROFILE_LOCKS
+#include <chrono>
+#include <iomanip>
+#include <map>
+#include <memory>
+#include <string>
+
+namespace {
+uint64_t nowNs() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                     std::chrono::steady_clock::now().time_since_epoch())
+                                     .count());
+}
+
+// Stats live until exit, when the registry's destructor prints them
+struct Registry {
+    std::mutex lock;
+    std::map<std::string, std::unique_ptr<LockStats>> locks;
+
+    ~Registry() {
+        if(!locks.empty()) {
+            reportLockProfile(std::cerr);
+        }
+    }
+};
+
+Registry& registry() {
+    static Registry instance;
+    return instance;
+}
+
+LockStats& statsFor(const char* name) {
+    Registry& r = registry();
+    std::lock_guard<std::mutex> lk(r.lock);
+    std::unique_ptr<LockStats>& stats = r.locks[name];
+    if(!stats) {
+        stats = std::make_unique<LockStats>();
+        stats->name = name;
+    }
+    return *stats;
+}
+} // namespace
+
+profiled_mutex::profiled_mutex(const char* _name) : stats(statsFor(_name)) {}
+
+void profiled_mutex::acquired() {
+    stats.acquisitions.fetch_add(1, std::memory_order_relaxed);
+    acquiredAt = nowNs();
+}
+
+void profiled_mutex::releasing() {
+    stats.holdNs.fetch_add(nowNs() - acquiredAt, std::memory_order_relaxed);
+}
+
+void profiled_mutex::lock() {
+    // The uncontended path costs one try_lock and one clock read
+    if(!internal_mutex.try_lock()) {
+        uint64_t start = nowNs();
+        internal_mutex.lock();
+        uint64_t waited = nowNs() - start;
+        stats.contended.fetch_add(1, std::memory_order_relaxed);
+        stats.waitNs.fetch_add(waited, std::memory_order_relaxed);
+        uint64_t max = stats.maxWaitNs.load(std::memory_order_relaxed);
+        while(waited > max &&
+              !stats.maxWaitNs.compare_exchange_weak(max, waited, std::memory_order_relaxed)) {
+        }
+    }
+    acquired();
+}
+
+bool profiled_mutex::try_lock() {
+    if(!internal_mutex.try_lock()) {
+        return false;
+    }
+    acquired();
+    return true;
+}
+
+void profiled_mutex::unlock() {
+    releasing();
+    internal_mutex.unlock();
+}
+
+uint64_t profiled_condition_variable::begin(profiled_mutex& m) {
+    m.releasing();
+    return nowNs();
+}
+
+void profiled_condition_variable::end(profiled_mutex& m, uint64_t start) {
+    m.stats.condWaits.fetch_add(1, std::memory_order_relaxed);
+    m.stats.condWaitNs.fetch_add(nowNs() - start, std::memory_order_relaxed);
+    m.acquired();
+}
+
+bool reportLockProfile(std::ostream& out) {
+    Registry& r = registry();
+    std::lock_guard<std::mutex> lk(r.lock);
+    auto ms = [](const std::atomic<uint64_t>& ns) { return ns.load() / 1e6; };
+    out << "[C++] Lock profile (times in ms)\n"
+        << std::left << std::setw(20) << "lock" << std::right << std::setw(12) << "acquired"
+        << std::setw(12) << "contended" << std::setw(12) << "wait" << std::setw(12) << "max wait"
+        << std::setw(12) << "held" << std::setw(12) << "cv waits" << std::setw(12) << "cv wait"
+        << '\n';
+    for(const auto& [name, stats] : r.locks) {
+        out << std::left << std::setw(20) << name << std::right << std::setw(12)
+            << stats->acquisitions.load() << std::setw(12) << stats->contended.load()
+            << std::setw(12) << ms(stats->waitNs) << std::setw(12) << ms(stats->maxWaitNs)
+            << std::setw(12) << ms(stats->holdNs) << std::setw(12) << stats->condWaits.load()
+            << std::setw(12) << ms(stats->condWaitNs) << '\n';
+    }
+    return static_cast<bool>(out);
+}
+#else
+bool reportLockProfile(std::ostream& out) {
+    out << "[C++] Built without OPTIC_PROFILE_LOCKS, no lock profile" << '\n';
+    return false;
+}
+#endif
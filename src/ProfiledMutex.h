@@ -0,0 +1,111 @@
+#ifndef PROFILED_MUTEX_H
+#define PROFILED_MUTEX_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <iosfwd>
+#include <mutex>
+
+// Drop-in std::mutex that records contention per lock name, the profiling sibling of
+// concurrencyIntermediates/hierarchicalMutex.cc. Built with OPTIC_PROFILE_LOCKS (CMake
+// option of the same name) every named lock counts acquisitions, contended acquisitions,
+// total and max time spent waiting to acquire, and time held; a profiled_condition_variable
+// waiting on it adds how often and how long its threads slept there. Instances sharing a name
+// share one set of counters, and every lock used is reported on stderr at exit, or whenever
+// reportLockProfile is called. Without the flag profiled_mutex is a std::mutex and
+// profiled_condition_variable a std::condition_variable, so nothing is measured or paid for.
+// Lock it through std::lock_guard / std::unique_lock<profiled_mutex>; names must be string
+// literals (or otherwise outlive the process).
+#ifdef OPTIC_PROFILE_LOCKS
+#include <atomic>
+
+struct LockStats {
+    const char* name{nullptr};
+    std::atomic<uint64_t> acquisitions{0};
+    std::atomic<uint64_t> contended{0};
+    std::atomic<uint64_t> waitNs{0};
+    std::atomic<uint64_t> maxWaitNs{0};
+    std::atomic<uint64_t> holdNs{0};
+    std::atomic<uint64_t> condWaits{0};
+    std::atomic<uint64_t> condWaitNs{0};
+};
+
+class profiled_mutex {
+  public:
+    explicit profiled_mutex(const char* _name);
+    profiled_mutex(const profiled_mutex&) = delete;
+    profiled_mutex& operator=(const profiled_mutex&) = delete;
+
+    void lock();
+    bool try_lock();
+    void unlock();
+
+  private:
+    friend class profiled_condition_variable;
+    std::mutex internal_mutex;
+    LockStats& stats;
+    uint64_t acquiredAt{0}; // only touched by the thread holding internal_mutex
+
+    void acquired();
+    void releasing();
+};
+
+class profiled_condition_variable {
+  public:
+    void notify_one() noexcept { cv.notify_one(); }
+    void notify_all() noexcept { cv.notify_all(); }
+
+    template <typename Predicate>
+    void wait(std::unique_lock<profiled_mutex>& lock, Predicate pred) {
+        if(pred()) {
+            return;
+        }
+        profiled_mutex& m = *lock.release();
+        uint64_t start = begin(m);
+        {
+            std::unique_lock<std::mutex> inner(m.internal_mutex, std::adopt_lock);
+            cv.wait(inner, pred);
+            inner.release();
+        }
+        end(m, start);
+        lock = std::unique_lock<profiled_mutex>(m, std::adopt_lock);
+    }
+
+  private:
+    std::condition_variable cv;
+
+    // Closes the hold the waiter had, then times the sleep and reopens it
+    static uint64_t begin(profiled_mutex& m);
+    static void end(profiled_mutex& m, uint64_t start);
+};
+#else
+class profiled_mutex : public std::mutex {
+  public:
+    explicit profiled_mutex(const char*) {}
+};
+
+// Hands the waiter's lock to a plain std::condition_variable and back; no bookkeeping
+class profiled_condition_variable {
+  public:
+    void notify_one() noexcept { cv.notify_one(); }
+    void notify_all() noexcept { cv.notify_all(); }
+
+    template <typename Predicate>
+    void wait(std::unique_lock<profiled_mutex>& lock, Predicate pred) {
+        profiled_mutex& m = *lock.release();
+        {
+            std::unique_lock<std::mutex> inner(m, std::adopt_lock);
+            cv.wait(inner, pred);
+            inner.release();
+        }
+        lock = std::unique_lock<profiled_mutex>(m, std::adopt_lock);
+    }
+
+  private:
+    std::condition_variable cv;
+};
+#endif
+
+// Table of every profiled lock so far. False (and a note) when profiling is compiled out.
+bool reportLockProfile(std::ostream& out);
+#endif
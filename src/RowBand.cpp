@@ -0,0 +1,146 @@
+#include "RowBand.h"
+#include "Filters.h"
+#include "Kernel.h"
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+RowBandFilter::RowBandFilter(int width, int height, int kernelSize, const std::string& filterType,
+                             RowSink sink)
+    : width(width), height(height), sink(std::move(sink)) {
+    // An even window has no centre row: the ring would emit one row too many
+    if(kernelSize < 1 || kernelSize % 2 == 0) {
+        throw std::invalid_argument("Kernel size must be odd and positive, got " +
+                                    std::to_string(kernelSize));
+    }
+
+    auto bindKernel = [this](auto kernel) {
+        windowRows = kernel.height;
+        borderWidth = kernel.width / 2;
+        convolveRow = [kernel, w = this->width](RowGrid& out, const RowGrid& window) {
+            for(int j = 0; j < w; j++) {
+                applyKernel(out, window, 0, j, kernel);
+            }
+        };
+    };
+
+    if(filterType == "sat") {
+        // Same window as satBoxBlur: radius (kernelSize - 1) / 2
+        useSat = true;
+        windowRows = 2 * ((kernelSize - 1) / 2) + 1;
+        borderWidth = windowRows / 2;
+    } else if(filterType == "boxblur") {
+        bindKernel(KernelFactory::BoxBlur(kernelSize));
+    } else if(filterType == "sobelx") {
+        bindKernel(KernelFactory::SobelX());
+    } else if(filterType == "sobely") {
+        bindKernel(KernelFactory::SobelY());
+    } else if(filterType == "gaussian") {
+        bindKernel(KernelFactory::GaussianBlur(kernelSize));
+    } else {
+        throw std::invalid_argument("Unknown filter type: " + filterType);
+    }
+
+    paddedWidth = width + 2 * borderWidth;
+    outRow.resize(width);
+    if(useSat) {
+        ring.resize(static_cast<size_t>(windowRows) * paddedWidth);
+        colSums.assign(paddedWidth, SatPixel{0, 0, 0, 0});
+        rowPrefix.resize(paddedWidth + 1);
+    } else {
+        ring.resize(2 * static_cast<size_t>(windowRows) * paddedWidth);
+    }
+}
+
+size_t RowBandFilter::getBufferBytes() const {
+    return ring.size() * sizeof(Pixel) + colSums.size() * sizeof(SatPixel) +
+           rowPrefix.size() * sizeof(SatPixel) + outRow.size() * sizeof(Pixel);
+}
+
+size_t RowBandFilter::predictBufferBytes(int width, int kernelSize,
+                                        const std::string& filterType) {
+    size_t rows = static_cast<size_t>(kernelSize);
+    if(filterType == "sat") {
+        rows = 2 * ((kernelSize - 1) / 2) + 1;
+    } else if(filterType == "sobelx" || filterType == "sobely") {
+        rows = 3;
+    }
+    size_t paddedWidth = width + 2 * (rows / 2);
+    size_t outBytes = width * sizeof(Pixel);
+    if(filterType == "sat") {
+        return rows * paddedWidth * sizeof(Pixel) + paddedWidth * sizeof(SatPixel) +
+               (paddedWidth + 1) * sizeof(SatPixel) + outBytes;
+    }
+    return 2 * rows * paddedWidth * sizeof(Pixel) + outBytes;
+}
+
+void RowBandFilter::pushRow(std::span<const Pixel> row) {
+    if(rowsPushed >= height) {
+        throw std::logic_error("RowBandFilter: more rows pushed than the image height");
+    }
+    int borderRows = windowRows / 2;
+
+    // Top border replicates the first row, bottom border replicates the last one
+    if(rowsPushed == 0) {
+        for(int i{0}; i < borderRows; i++)
+            pushPaddedRow(row);
+    }
+    pushPaddedRow(row);
+    rowsPushed++;
+    if(rowsPushed == height) {
+        for(int i{0}; i < borderRows; i++)
+            pushPaddedRow(row);
+    }
+}
+
+void RowBandFilter::pushPaddedRow(std::span<const Pixel> row) {
+    int slot = paddedRowsPushed % windowRows;
+    Pixel* dst = &ring[static_cast<size_t>(slot) * paddedWidth];
+
+    // The slot still holds the row leaving the window, take it out of the running column sums
+    if(useSat && paddedRowsPushed >= windowRows) {
+        for(int c{0}; c < paddedWidth; c++)
+            colSums[c] -= dst[c];
+    }
+
+    std::fill(dst, dst + borderWidth, row[0]);
+    std::copy(row.begin(), row.begin() + width, dst + borderWidth);
+    std::fill(dst + borderWidth + width, dst + paddedWidth, row[width - 1]);
+
+    if(useSat) {
+        for(int c{0}; c < paddedWidth; c++)
+            colSums[c] += dst[c];
+    } else {
+        std::copy(dst, dst + paddedWidth, dst + static_cast<size_t>(windowRows) * paddedWidth);
+    }
+
+    paddedRowsPushed++;
+    if(paddedRowsPushed >= windowRows) {
+        emitRow();
+    }
+}
+
+void RowBandFilter::emitRow() {
+    if(useSat) {
+        // One row of the SAT is enough: prefix over the column sums of the window
+        rowPrefix[0] = {0, 0, 0, 0};
+        for(int c{0}; c < paddedWidth; c++)
+            rowPrefix[c + 1] = rowPrefix[c] + colSums[c];
+
+        uint32_t area = static_cast<uint32_t>(windowRows * windowRows);
+        for(int j{0}; j < width; j++) {
+            const SatPixel& hi = rowPrefix[j + windowRows];
+            const SatPixel& lo = rowPrefix[j];
+            outRow[j] = {static_cast<uint8_t>((hi.r - lo.r) / area),
+                         static_cast<uint8_t>((hi.g - lo.g) / area),
+                         static_cast<uint8_t>((hi.b - lo.b) / area), 255};
+        }
+    } else {
+        int firstRow = paddedRowsPushed - windowRows;
+        int slot = firstRow % windowRows;
+        RowGrid window(&ring[static_cast<size_t>(slot) * paddedWidth], windowRows, paddedWidth);
+        RowGrid out(outRow.data(), 1, width);
+        convolveRow(out, window);
+    }
+    sink(rowsEmitted++, outRow);
+}
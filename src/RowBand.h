@@ -0,0 +1,57 @@
+#ifndef ROW_BAND_H
+#define ROW_BAND_H
+
+#include "Pixel.h"
+#include <cstddef>
+#include <functional>
+#include <mdspan>
+#include <span>
+#include <string>
+#include <vector>
+
+// Streaming executor for the convolution filters.
+// Rows are pushed top to bottom, and each output row is handed to the sink as soon as the
+// kernel window below it is complete. Only a ring of K padded rows is kept (plus one row of
+// running column sums for "sat"), so memory grows with width * K instead of width * height.
+class RowBandFilter {
+  public:
+    using RowSink = std::function<void(int rowNum, std::span<const Pixel> row)>;
+
+    RowBandFilter(int width, int height, int kernelSize, const std::string& filterType,
+                  RowSink sink);
+
+    // Rows must arrive in order, exactly `height` of them
+    void pushRow(std::span<const Pixel> row);
+
+    size_t getBufferBytes() const;
+    // Same figure as getBufferBytes() without building the ring
+    static size_t predictBufferBytes(int width, int kernelSize, const std::string& filterType);
+
+  private:
+    using RowGrid = std::mdspan<Pixel, std::dextents<size_t, 2>>;
+
+    int width;
+    int height;
+    int windowRows{0};
+    int borderWidth{0};
+    int paddedWidth{0};
+    bool useSat{false};
+
+    RowSink sink;
+    std::function<void(RowGrid& outRow, const RowGrid& window)> convolveRow;
+
+    // Ring of padded rows. For kernels every row is stored twice (slot and slot + K) so any
+    // K consecutive rows form one contiguous window that applyKernel can walk directly.
+    std::vector<Pixel> ring;
+    std::vector<SatPixel> colSums;
+    std::vector<SatPixel> rowPrefix;
+    std::vector<Pixel> outRow;
+
+    int rowsPushed{0};
+    int paddedRowsPushed{0};
+    int rowsEmitted{0};
+
+    void pushPaddedRow(std::span<const Pixel> row);
+    void emitRow();
+};
+#endif
@@ -0,0 +1,62 @@
+#ifndef STAGE_TIMINGS_H
+#define STAGE_TIMINGS_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Wall-clock durations of the stages of one job (decode, pad, sat, filter, write, ...),
+// in the order they ran. Recorded by the thread driving the job, so no locking.
+class StageTimings {
+  public:
+    struct Stage {
+        std::string name;
+        uint64_t ns;
+    };
+
+    void clear() { stages.clear(); }
+    // Drops everything after the first `count` stages (a new filter on an already loaded image)
+    void truncate(size_t count) { stages.resize(std::min(count, stages.size())); }
+    size_t size() const { return stages.size(); }
+    void add(std::string name, uint64_t ns) { stages.push_back({std::move(name), ns}); }
+    const std::vector<Stage>& getStages() const { return stages; }
+
+    // {"stages":[{"name":"decode","ns":1234},...],"total_ns":5678}
+    std::string toJson() const {
+        std::string json{"{\"stages\":["};
+        uint64_t total{0};
+        for(size_t i{0}; i < stages.size(); i++) {
+            json += (i ? ",{\"name\":\"" : "{\"name\":\"") + stages[i].name +
+                    "\",\"ns\":" + std::to_string(stages[i].ns) + "}";
+            total += stages[i].ns;
+        }
+        return json + "],\"total_ns\":" + std::to_string(total) + "}";
+    }
+
+  private:
+    std::vector<Stage> stages;
+};
+
+// Adds the lifetime of the scope to `timings` under `name`
+class ScopedTimer {
+  public:
+    ScopedTimer(StageTimings& _timings, std::string _name)
+        : timings(_timings), name(std::move(_name)), start(std::chrono::steady_clock::now()) {}
+    ~ScopedTimer() {
+        timings.add(std::move(name), static_cast<uint64_t>(
+                                         std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                             std::chrono::steady_clock::now() - start)
+                                             .count()));
+    }
+    ScopedTimer(const ScopedTimer&) = delete;
+    ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+  private:
+    StageTimings& timings;
+    std::string name;
+    std::chrono::steady_clock::time_point start;
+};
+#endif
@@ -0,0 +1,159 @@
+#include "StreamingPipeline.h"
+#include "BoundedQueue.h"
+#include "PngStreamDecoder.h"
+#include "RowBand.h"
+#include "Trace.h"
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <optional>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+namespace {
+struct Band {
+    std::vector<uint8_t> pixels;
+    int rows{0};
+};
+constexpr size_t bandsInFlight = 3;
+
+using Clock = std::chrono::steady_clock;
+
+uint64_t elapsedNs(Clock::time_point start) {
+    return static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count());
+}
+} // namespace
+
+bool runStreamingPng(const std::string& inputPath, const std::string& outputPath,
+                     const std::string& filterType, int kernelSize, PpmOutputMode outputMode,
+                     StreamingStats* stats, int bandRows) {
+    PngStreamDecoder decoder;
+    if(!decoder.open(inputPath)) {
+        return false;
+    }
+    int width = decoder.getWidth();
+    int height = decoder.getHeight();
+    size_t rowBytes = static_cast<size_t>(width) * 4;
+    size_t bandBytes = rowBytes * bandRows;
+
+    // Free lists recycle the band buffers, so the footprint is fixed up front
+    BoundedQueue<Band> freeInput(bandsInFlight), decoded(bandsInFlight);
+    BoundedQueue<Band> freeOutput(bandsInFlight), filtered(bandsInFlight);
+    for(size_t i{0}; i < bandsInFlight; i++) {
+        freeInput.push(Band{std::vector<uint8_t>(bandBytes)});
+        freeOutput.push(Band{std::vector<uint8_t>(bandBytes)});
+    }
+
+    std::optional<Band> outBand = freeOutput.pop();
+    auto sink = [&](int, std::span<const Pixel> row) {
+        std::memcpy(outBand->pixels.data() + outBand->rows * rowBytes, row.data(), rowBytes);
+        if(++outBand->rows == bandRows) {
+            filtered.push(std::move(*outBand));
+            outBand = freeOutput.pop();
+            outBand->rows = 0;
+        }
+    };
+
+    std::optional<RowBandFilter> rowFilter;
+    try {
+        rowFilter.emplace(width, height, kernelSize, filterType, sink);
+    } catch(const std::invalid_argument& e) {
+        std::cerr << "[C++] " << e.what() << std::endl;
+        return false;
+    }
+
+    PpmWriter writer;
+    if(!writer.open(outputPath, width, height, outputMode)) {
+        return false;
+    }
+
+    if(stats) {
+        stats->width = width;
+        stats->height = height;
+        stats->bufferBytes = 2 * bandsInFlight * bandBytes + rowFilter->getBufferBytes() +
+                             decoder.getBufferBytes();
+    }
+
+    std::atomic<bool> decodeFailed{false};
+    std::atomic<bool> encodeFailed{false};
+    // Each written by its own stage's thread, read after the joins
+    uint64_t decodeNs{0}, filterNs{0}, encodeNs{0};
+
+    std::thread decodeThread([&] {
+        OPTIC_TRACE_THREAD_NAME("png decode");
+        while(std::optional<Band> band = freeInput.pop()) {
+            Clock::time_point start = Clock::now();
+            int rows{0};
+            {
+                OPTIC_TRACE_SCOPE("decode band");
+                rows = decoder.readRows(band->pixels.data(), bandRows);
+            }
+            decodeNs += elapsedNs(start);
+            if(rows < 0) {
+                decodeFailed = true;
+                break;
+            }
+            if(rows == 0) {
+                break;
+            }
+            band->rows = rows;
+            decoded.push(std::move(*band));
+        }
+        decoded.close();
+    });
+
+    std::thread encodeThread([&] {
+        OPTIC_TRACE_THREAD_NAME("ppm encode");
+        while(std::optional<Band> band = filtered.pop()) {
+            Clock::time_point start = Clock::now();
+            {
+                OPTIC_TRACE_SCOPE("encode band");
+                if(!writer.writeRows(band->pixels.data(), band->rows)) {
+                    encodeFailed = true;
+                }
+            }
+            encodeNs += elapsedNs(start);
+            freeOutput.push(std::move(*band));
+        }
+    });
+
+    while(std::optional<Band> band = decoded.pop()) {
+        // Includes waits on the encoder when it falls behind: the sink blocks for a free band
+        Clock::time_point start = Clock::now();
+        {
+            OPTIC_TRACE_SCOPE("filter band");
+            for(int r{0}; r < band->rows; r++) {
+                const Pixel* row =
+                    reinterpret_cast<const Pixel*>(band->pixels.data() + r * rowBytes);
+                rowFilter->pushRow(std::span<const Pixel>(row, width));
+            }
+        }
+        filterNs += elapsedNs(start);
+        band->rows = 0;
+        freeInput.push(std::move(*band));
+    }
+    if(outBand->rows > 0) {
+        filtered.push(std::move(*outBand));
+    }
+
+    freeInput.close();
+    filtered.close();
+    decodeThread.join();
+    encodeThread.join();
+    freeOutput.close();
+    if(stats) {
+        stats->timings.clear();
+        stats->timings.add("decode", decodeNs);
+        stats->timings.add("filter", filterNs);
+        stats->timings.add("encode", encodeNs);
+    }
+
+    bool ok = writer.close() && !decodeFailed && !encodeFailed;
+    if(!ok) {
+        std::cerr << "[C++] Streaming pipeline failed for " << inputPath << std::endl;
+    }
+    return ok;
+}
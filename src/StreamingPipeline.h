@@ -0,0 +1,26 @@
+#ifndef STREAMING_PIPELINE_H
+#define STREAMING_PIPELINE_H
+
+#include "PpmWriter.h"
+#include "StageTimings.h"
+#include <cstddef>
+#include <string>
+
+struct StreamingStats {
+    int width{0};
+    int height{0};
+    size_t bufferBytes{0};
+    // Busy time of the decode, filter and encode stages. They overlap, so these add up to
+    // more than the wall time
+    StageTimings timings;
+};
+
+// PNG in, filtered P6 out, without ever holding the full image.
+// Three stages joined by bounded queues of row bands: the decoder thread inflates band N+1
+// while this thread pushes band N through a RowBandFilter and the encoder thread writes the
+// bands that already came out.
+bool runStreamingPng(const std::string& inputPath, const std::string& outputPath,
+                     const std::string& filterType, int kernelSize,
+                     PpmOutputMode outputMode = PpmOutputMode::BUFFERED,
+                     StreamingStats* stats = nullptr, int bandRows = 64);
+#endif
@@ -0,0 +1,196 @@
+#include "ThreadPool.h"
+#include "Trace.h"
+#include <algorithm>
+
+namespace {
+// Which pool the current thread works for, and its deque there
+thread_local const ThreadPool* currentPool{nullptr};
+thread_local int currentQueue{-1};
+} // namespace
+
+ThreadPool::ThreadPool(int threads) {
+#ifndef __EMSCRIPTEN__
+    if(threads <= 0) {
+        threads = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+    }
+    for(int t{0}; t < threads; t++)
+        queues.push_back(std::make_unique<Queue>());
+    for(int t{0}; t + 1 < threads; t++)
+        workers.emplace_back(&ThreadPool::workerLoop, this, t);
+#else
+    queues.push_back(std::make_unique<Queue>());
+#endif
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lk(m);
+        stopping = true;
+    }
+    wake.notify_all();
+    for(auto& t : workers)
+        t.join();
+}
+
+int ThreadPool::localQueue() const {
+    return currentPool == this ? currentQueue : static_cast<int>(queues.size()) - 1;
+}
+
+void ThreadPool::finish(Task& task) {
+    if(task.group->pending.fetch_sub(1) == 1) {
+        // Taking the lock orders this against a waiter that just found pending > 0
+        { std::lock_guard<std::mutex> lk(m); }
+        wake.notify_all();
+    }
+}
+
+bool ThreadPool::runOne(int self) {
+    Task task;
+    bool found{false};
+    {
+        // Own deque from the back: the most recently pushed, still-warm work
+        Queue& own = *queues[self];
+        std::lock_guard<std::mutex> lk(own.lock);
+        if(!own.tasks.empty()) {
+            task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            found = true;
+        }
+    }
+    // Then steal from the front of the others, starting with the next one along
+    for(size_t i{1}; !found && i < queues.size(); i++) {
+        Queue& victim = *queues[(self + i) % queues.size()];
+        std::lock_guard<std::mutex> lk(victim.lock);
+        if(!victim.tasks.empty()) {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            found = true;
+        }
+    }
+    if(!found) {
+        return false;
+    }
+    queued--;
+    {
+        OPTIC_TRACE_SCOPE("task");
+        task.run();
+    }
+    finish(task);
+    return true;
+}
+
+void ThreadPool::workerLoop(int index) {
+    OPTIC_TRACE_THREAD_NAME("pool worker");
+    currentPool = this;
+    currentQueue = index;
+    for(;;) {
+        if(runOne(index)) {
+            continue;
+        }
+        std::unique_lock<std::mutex> lk(m);
+        wake.wait(lk, [&] { return stopping || queued > 0; });
+        if(stopping) {
+            return;
+        }
+    }
+}
+
+void ThreadPool::submit(TaskGroup& group, std::function<void()> task) {
+    group.pending++;
+    if(workers.empty()) {
+        Task inline_{std::move(task), &group};
+        inline_.run();
+        finish(inline_);
+        return;
+    }
+    Queue& own = *queues[localQueue()];
+    {
+        std::lock_guard<std::mutex> lk(own.lock);
+        own.tasks.push_back({std::move(task), &group});
+    }
+    {
+        std::lock_guard<std::mutex> lk(m);
+        queued++;
+    }
+    wake.notify_one();
+}
+
+void ThreadPool::wait(TaskGroup& group) {
+    int self = localQueue();
+    while(group.pending > 0) {
+        if(runOne(self)) {
+            continue;
+        }
+        // Nothing left to help with: the group's last tasks are running elsewhere
+        std::unique_lock<std::mutex> lk(m);
+        wake.wait(lk, [&] { return group.pending == 0 || queued > 0; });
+    }
+}
+
+void ThreadPool::runBatch(int count, const std::function<void(int)>& item) {
+    TaskGroup group;
+    group.pending = count;
+    int self = localQueue();
+    int deques = static_cast<int>(queues.size());
+    for(int q{0}; q < deques; q++) {
+        // The caller's own deque gets the first block, the rest go round from there
+        Queue& queue = *queues[(self + q) % deques];
+        int first = count * q / deques;
+        int last = count * (q + 1) / deques;
+        std::lock_guard<std::mutex> lk(queue.lock);
+        // Pushed high to low, so popping from the back walks the block in order
+        for(int i{last - 1}; i >= first; i--)
+            queue.tasks.push_back({[&item, i] { item(i); }, &group});
+    }
+    {
+        std::lock_guard<std::mutex> lk(m);
+        queued += count;
+    }
+    wake.notify_all();
+    wait(group);
+}
+
+void ThreadPool::parallelFor(int begin, int end, int grain,
+                             const std::function<void(int, int)>& fn) {
+    if(end <= begin) {
+        return;
+    }
+    grain = std::max(1, grain);
+    int chunks = (end - begin + grain - 1) / grain;
+    if(workers.empty() || chunks == 1) {
+        fn(begin, end);
+        return;
+    }
+    runBatch(chunks, [&](int chunk) {
+        int first = begin + chunk * grain;
+        fn(first, std::min(end, first + grain));
+    });
+}
+
+void ThreadPool::parallelFor2D(int rowBegin, int rowEnd, int colBegin, int colEnd, int rowGrain,
+                               int colGrain, const std::function<void(const Tile&)>& fn) {
+    if(rowEnd <= rowBegin || colEnd <= colBegin) {
+        return;
+    }
+    rowGrain = std::max(1, rowGrain);
+    colGrain = std::max(1, colGrain);
+    int tileRows = (rowEnd - rowBegin + rowGrain - 1) / rowGrain;
+    int tileCols = (colEnd - colBegin + colGrain - 1) / colGrain;
+    auto tile = [&](int index) {
+        int r = rowBegin + (index / tileCols) * rowGrain;
+        int c = colBegin + (index % tileCols) * colGrain;
+        return Tile{r, std::min(rowEnd, r + rowGrain), c, std::min(colEnd, c + colGrain)};
+    };
+    if(workers.empty() || tileRows * tileCols == 1) {
+        for(int i{0}; i < tileRows * tileCols; i++)
+            fn(tile(i));
+        return;
+    }
+    // Row-major tile order, so each deque's block is a band of whole tile rows
+    runBatch(tileRows * tileCols, [&](int index) { fn(tile(index)); });
+}
+
+ThreadPool& sharedThreadPool() {
+    static ThreadPool pool;
+    return pool;
+}
@@ -0,0 +1,79 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Persistent work-stealing pool. Every worker owns a deque: it pops its own tasks from the
+// back and, once that runs dry, steals from the front of the others'. Threads outside the
+// pool push into one extra shared deque. parallelFor and parallelFor2D hand each deque a
+// contiguous block of chunks, so a worker stays on neighbouring memory until it has to
+// steal. wait() runs queued tasks instead of blocking, so loops may nest and any number of
+// callers can share the pool at once.
+// Built without threads (wasm), everything runs inline on the caller.
+class ThreadPool {
+  public:
+    // Counts a batch of submitted tasks down to zero
+    class TaskGroup {
+        friend class ThreadPool;
+        std::atomic<int> pending{0};
+    };
+
+    struct Tile {
+        int rowBegin, rowEnd;
+        int colBegin, colEnd;
+    };
+
+    // threads = total participants including the caller, 0 = one per core
+    explicit ThreadPool(int threads = 0);
+    ~ThreadPool();
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    int size() const { return static_cast<int>(workers.size()) + 1; }
+
+    void submit(TaskGroup& group, std::function<void()> task);
+    // Returns once every task in the group has run, running pool tasks meanwhile
+    void wait(TaskGroup& group);
+
+    void parallelFor(int begin, int end, int grain, const std::function<void(int, int)>& body);
+    // [rowBegin, rowEnd) x [colBegin, colEnd) in tiles of at most rowGrain x colGrain
+    void parallelFor2D(int rowBegin, int rowEnd, int colBegin, int colEnd, int rowGrain,
+                       int colGrain, const std::function<void(const Tile&)>& body);
+
+  private:
+    struct Task {
+        std::function<void()> run;
+        TaskGroup* group;
+    };
+    struct Queue {
+        std::mutex lock;
+        std::deque<Task> tasks;
+    };
+
+    std::vector<std::thread> workers;
+    // One per worker, then the shared one for outside threads
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::atomic<int> queued{0};
+    std::mutex m;
+    std::condition_variable wake; // new tasks, a finished group, or shutdown
+    bool stopping{false};
+
+    int localQueue() const;
+    bool runOne(int self);
+    void finish(Task& task);
+    void workerLoop(int index);
+    // Runs item(0..count) as tasks spread in contiguous blocks over the deques
+    void runBatch(int count, const std::function<void(int)>& item);
+};
+
+// Process-wide pool shared by ImageProcessor and the pipeline stages
+ThreadPool& sharedThreadPool();
+#endif
@@ -0,0 +1,508 @@
+#include "TiffReader.h"
+#include <algorithm>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <new>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+#include <zlib.h>
+
+namespace {
+enum TiffTag : uint16_t {
+    IMAGE_WIDTH = 256,
+    IMAGE_LENGTH = 257,
+    BITS_PER_SAMPLE = 258,
+    COMPRESSION = 259,
+    PHOTOMETRIC = 262,
+    STRIP_OFFSETS = 273,
+    SAMPLES_PER_PIXEL = 277,
+    ROWS_PER_STRIP = 278,
+    STRIP_BYTE_COUNTS = 279,
+    PLANAR_CONFIG = 284,
+    PREDICTOR = 317,
+    TILE_WIDTH = 322,
+    TILE_LENGTH = 323,
+    TILE_OFFSETS = 324,
+    TILE_BYTE_COUNTS = 325,
+    SAMPLE_FORMAT = 339,
+};
+
+enum TiffCompression { NONE = 1, LZW = 5, DEFLATE = 8, PACKBITS = 32773, DEFLATE_OLD = 32946 };
+
+// Bounds on what the header may ask us to allocate: a side, and one tile or strip
+constexpr uint64_t maxDimension = uint64_t{1} << 20;
+constexpr uint64_t maxTilePixels = uint64_t{1} << 26;
+
+size_t typeSize(uint16_t type) {
+    switch(type) {
+    case 1: case 2: case 6: case 7: return 1;  // BYTE, ASCII, SBYTE, UNDEFINED
+    case 3: case 8: return 2;                  // SHORT, SSHORT
+    case 4: case 9: case 11: case 13: return 4; // LONG, SLONG, FLOAT, IFD
+    case 5: case 10: case 12: case 16: case 17: case 18: return 8;
+    default: return 0;
+    }
+}
+
+// TIFF flavour of LZW: MSB-first codes, 9 to 12 bits, width grows one code early
+bool decodeLzw(const uint8_t* in, size_t inSize, uint8_t* out, size_t outSize) {
+    struct Entry {
+        uint16_t prefix;
+        uint8_t suffix;
+        uint8_t first;
+        uint32_t length;
+    };
+    constexpr int clearCode = 256, endCode = 257;
+    std::vector<Entry> table(4096);
+    for(int i{0}; i < 256; i++)
+        table[i] = {0xFFFF, static_cast<uint8_t>(i), static_cast<uint8_t>(i), 1};
+
+    size_t bitPos{0}, outPos{0};
+    int codeWidth{9}, nextCode{258}, prevCode{-1};
+
+    auto readCode = [&]() -> int {
+        if(bitPos + codeWidth > inSize * 8)
+            return endCode;
+        size_t byte = bitPos >> 3;
+        uint32_t window = uint32_t{in[byte]} << 16;
+        if(byte + 1 < inSize)
+            window |= uint32_t{in[byte + 1]} << 8;
+        if(byte + 2 < inSize)
+            window |= in[byte + 2];
+        int code = (window >> (24 - (bitPos & 7) - codeWidth)) & ((1 << codeWidth) - 1);
+        bitPos += codeWidth;
+        return code;
+    };
+    // Strings are stored as prefix chains, so they are written back to front
+    auto emit = [&](int code) {
+        uint32_t length = table[code].length;
+        for(int c = code, i = static_cast<int>(length) - 1; c != 0xFFFF; c = table[c].prefix, --i) {
+            if(outPos + i < outSize)
+                out[outPos + i] = table[c].suffix;
+        }
+        outPos += length;
+    };
+
+    while(outPos < outSize) {
+        int code = readCode();
+        if(code == endCode)
+            break;
+        if(code == clearCode) {
+            codeWidth = 9;
+            nextCode = 258;
+            prevCode = -1;
+            continue;
+        }
+        if(prevCode < 0) {
+            if(code > 255)
+                return false;
+            emit(code);
+            prevCode = code;
+            continue;
+        }
+        if(code > nextCode || nextCode >= 4096)
+            return false;
+        uint8_t first = code < nextCode ? table[code].first : table[prevCode].first;
+        table[nextCode] = {static_cast<uint16_t>(prevCode), first, table[prevCode].first,
+                           table[prevCode].length + 1};
+        emit(code);
+        nextCode++;
+        if(nextCode >= (1 << codeWidth) - 1 && codeWidth < 12)
+            codeWidth++;
+        prevCode = code;
+    }
+    return outPos >= outSize;
+}
+
+bool decodePackBits(const uint8_t* in, size_t inSize, uint8_t* out, size_t outSize) {
+    size_t inPos{0}, outPos{0};
+    while(inPos < inSize && outPos < outSize) {
+        int8_t header = static_cast<int8_t>(in[inPos++]);
+        if(header >= 0) {
+            size_t count = std::min<size_t>(header + 1, std::min(outSize - outPos, inSize - inPos));
+            std::memcpy(out + outPos, in + inPos, count);
+            inPos += count;
+            outPos += count;
+        } else if(header != -128 && inPos < inSize) {
+            size_t count = std::min<size_t>(1 - header, outSize - outPos);
+            std::memset(out + outPos, in[inPos++], count);
+            outPos += count;
+        }
+    }
+    return outPos == outSize;
+}
+} // namespace
+
+bool isTiffFile(const std::string& path) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if(fd < 0) {
+        return false;
+    }
+    uint8_t magic[4]{};
+    bool match = ::pread(fd, magic, 4, 0) == 4 &&
+                 ((magic[0] == 'I' && magic[1] == 'I' && (magic[2] == 42 || magic[2] == 43)) ||
+                  (magic[0] == 'M' && magic[1] == 'M' && (magic[3] == 42 || magic[3] == 43)));
+    ::close(fd);
+    return match;
+}
+
+TiffReader::~TiffReader() {
+    if(fd >= 0) {
+        ::close(fd);
+    }
+}
+
+bool TiffReader::readAt(uint64_t offset, void* dst, size_t bytes) const {
+    uint8_t* cursor = static_cast<uint8_t*>(dst);
+    while(bytes > 0) {
+        ssize_t got = ::pread(fd, cursor, bytes, static_cast<off_t>(offset));
+        if(got <= 0) {
+            return false;
+        }
+        cursor += got;
+        offset += got;
+        bytes -= got;
+        bytesRead += got;
+    }
+    return true;
+}
+
+bool TiffReader::open(const std::string& path) {
+    fd = ::open(path.c_str(), O_RDONLY);
+    if(fd < 0) {
+        std::cerr << "[C++] Cannot open " << path << '\n';
+        return false;
+    }
+    uint8_t header[16]{};
+    if(!readAt(0, header, 8)) {
+        return false;
+    }
+    if(header[0] == 'I' && header[1] == 'I') {
+        bigEndian = false;
+    } else if(header[0] == 'M' && header[1] == 'M') {
+        bigEndian = true;
+    } else {
+        std::cerr << "[C++] " << path << " is not a TIFF file" << '\n';
+        return false;
+    }
+    auto u16 = [&](const uint8_t* p) {
+        return bigEndian ? static_cast<uint16_t>((p[0] << 8) | p[1])
+                         : static_cast<uint16_t>(p[0] | (p[1] << 8));
+    };
+    uint16_t version = u16(header + 2);
+    uint64_t firstIfd{0};
+    if(version == 42) {
+        firstIfd = bigEndian ? (uint64_t{header[4]} << 24 | header[5] << 16 | header[6] << 8 | header[7])
+                             : (uint64_t{header[7]} << 24 | header[6] << 16 | header[5] << 8 | header[4]);
+    } else if(version == 43 && readAt(8, header + 8, 8)) {
+        tiffInfo.bigTiff = true;
+        for(int i{0}; i < 8; i++) {
+            uint64_t byte = header[8 + i];
+            firstIfd |= bigEndian ? byte << (8 * (7 - i)) : byte << (8 * i);
+        }
+    } else {
+        std::cerr << "[C++] Unknown TIFF version " << version << '\n';
+        return false;
+    }
+    return parseIfd(firstIfd);
+}
+
+bool TiffReader::parseIfd(uint64_t offset) {
+    const bool big = tiffInfo.bigTiff;
+    auto readUnsigned = [&](const uint8_t* p, size_t bytes) {
+        uint64_t value{0};
+        for(size_t i{0}; i < bytes; i++) {
+            uint64_t byte = p[i];
+            value |= bigEndian ? byte << (8 * (bytes - 1 - i)) : byte << (8 * i);
+        }
+        return value;
+    };
+
+    // Nothing the IFD describes (entries, value arrays, tiles) can be bigger than the file
+    struct stat fileStat{};
+    if(::fstat(fd, &fileStat) != 0) {
+        return false;
+    }
+    const uint64_t fileBytes = static_cast<uint64_t>(fileStat.st_size);
+
+    uint8_t countBytes[8];
+    if(!readAt(offset, countBytes, big ? 8 : 2)) {
+        return false;
+    }
+    uint64_t entryCount = readUnsigned(countBytes, big ? 8 : 2);
+    size_t entrySize = big ? 20 : 12;
+    if(entryCount > fileBytes / entrySize) {
+        std::cerr << "[C++] TIFF directory has more entries than the file can hold" << '\n';
+        return false;
+    }
+    std::vector<uint8_t> entries(entryCount * entrySize);
+    if(!readAt(offset + (big ? 8 : 2), entries.data(), entries.size())) {
+        return false;
+    }
+
+    // Values that don't fit in the entry live elsewhere in the file (offset arrays mostly)
+    auto tagValues = [&](const uint8_t* entry) -> std::vector<uint64_t> {
+        uint16_t type = static_cast<uint16_t>(readUnsigned(entry + 2, 2));
+        uint64_t count = readUnsigned(entry + 4, big ? 8 : 4);
+        size_t size = typeSize(type);
+        const uint8_t* valueField = entry + (big ? 12 : 8);
+        size_t inlineBytes = big ? 8 : 4;
+        if(size == 0 || count > fileBytes / size) {
+            return {};
+        }
+        std::vector<uint8_t> raw(size * count);
+        if(raw.size() <= inlineBytes) {
+            std::memcpy(raw.data(), valueField, raw.size());
+        } else if(!readAt(readUnsigned(valueField, inlineBytes), raw.data(), raw.size())) {
+            return {};
+        }
+        std::vector<uint64_t> values(count);
+        for(uint64_t i{0}; i < count; i++)
+            values[i] = readUnsigned(raw.data() + i * size, std::min<size_t>(size, 8));
+        return values;
+    };
+
+    uint64_t rowsPerStrip{0};
+    std::vector<uint64_t> stripOffsets, stripByteCounts;
+    int planarConfig{1}, sampleFormat{1};
+    // Anything past maxDimension is rejected below; clamping keeps the cast from wrapping
+    auto dimension = [](uint64_t value) {
+        return static_cast<int>(std::min(value, maxDimension + 1));
+    };
+    for(uint64_t e{0}; e < entryCount; e++) {
+        const uint8_t* entry = entries.data() + e * entrySize;
+        uint16_t tag = static_cast<uint16_t>(readUnsigned(entry, 2));
+        std::vector<uint64_t> values = tagValues(entry);
+        if(values.empty()) {
+            continue;
+        }
+        switch(tag) {
+        case IMAGE_WIDTH: tiffInfo.width = dimension(values[0]); break;
+        case IMAGE_LENGTH: tiffInfo.height = dimension(values[0]); break;
+        case BITS_PER_SAMPLE: tiffInfo.bitsPerSample = static_cast<int>(values[0]); break;
+        case COMPRESSION: tiffInfo.compression = static_cast<int>(values[0]); break;
+        case PHOTOMETRIC: tiffInfo.photometric = static_cast<int>(values[0]); break;
+        case SAMPLES_PER_PIXEL: tiffInfo.samplesPerPixel = static_cast<int>(values[0]); break;
+        case ROWS_PER_STRIP: rowsPerStrip = values[0]; break;
+        case PLANAR_CONFIG: planarConfig = static_cast<int>(values[0]); break;
+        case PREDICTOR: tiffInfo.predictor = static_cast<int>(values[0]); break;
+        case SAMPLE_FORMAT: sampleFormat = static_cast<int>(values[0]); break;
+        case TILE_WIDTH: tiffInfo.tileWidth = dimension(values[0]); break;
+        case TILE_LENGTH: tiffInfo.tileHeight = dimension(values[0]); break;
+        case TILE_OFFSETS: tileOffsets = std::move(values); break;
+        case TILE_BYTE_COUNTS: tileByteCounts = std::move(values); break;
+        case STRIP_OFFSETS: stripOffsets = std::move(values); break;
+        case STRIP_BYTE_COUNTS: stripByteCounts = std::move(values); break;
+        default: break;
+        }
+    }
+
+    TiffInfo& info = tiffInfo;
+    info.tiled = !tileOffsets.empty();
+    if(!info.tiled) {
+        // A strip is just a tile as wide as the image
+        info.tileWidth = info.width;
+        info.tileHeight = static_cast<int>(std::min<uint64_t>(
+            rowsPerStrip == 0 ? info.height : rowsPerStrip, static_cast<uint64_t>(info.height)));
+        tileOffsets = std::move(stripOffsets);
+        tileByteCounts = std::move(stripByteCounts);
+    }
+    if(info.width <= 0 || info.height <= 0 || info.tileWidth <= 0 || info.tileHeight <= 0) {
+        std::cerr << "[C++] TIFF is missing its geometry tags" << '\n';
+        return false;
+    }
+    if(static_cast<uint64_t>(info.width) > maxDimension ||
+       static_cast<uint64_t>(info.height) > maxDimension ||
+       static_cast<uint64_t>(info.tileWidth) > maxDimension ||
+       static_cast<uint64_t>(info.tileHeight) > maxDimension ||
+       static_cast<uint64_t>(info.tileWidth) * info.tileHeight > maxTilePixels) {
+        std::cerr << "[C++] TIFF geometry too large (" << info.width << "x" << info.height
+                  << " in " << info.tileWidth << "x" << info.tileHeight << " tiles)" << '\n';
+        return false;
+    }
+    info.tilesAcross = (info.width + info.tileWidth - 1) / info.tileWidth;
+    info.tilesDown = (info.height + info.tileHeight - 1) / info.tileHeight;
+
+    bool compressionOk = info.compression == NONE || info.compression == LZW ||
+                         info.compression == DEFLATE || info.compression == DEFLATE_OLD ||
+                         info.compression == PACKBITS;
+    if(!compressionOk || planarConfig != 1 || sampleFormat != 1 ||
+       (info.bitsPerSample != 8 && info.bitsPerSample != 16) || info.samplesPerPixel < 1 ||
+       info.samplesPerPixel > 4 || (info.predictor != 1 && info.predictor != 2)) {
+        std::cerr << "[C++] Unsupported TIFF layout (compression " << info.compression
+                  << ", planar " << planarConfig << ", " << info.bitsPerSample << "-bit x "
+                  << info.samplesPerPixel << ")" << '\n';
+        return false;
+    }
+    // Palette and YCbCr would need their own conversion; only gray (0, 1) and RGB (2) decode
+    bool grayOk = (info.photometric == 0 || info.photometric == 1) && info.samplesPerPixel <= 2;
+    bool rgbOk = info.photometric == 2 && info.samplesPerPixel >= 3;
+    if(!grayOk && !rgbOk) {
+        std::cerr << "[C++] Unsupported TIFF photometric interpretation " << info.photometric
+                  << " with " << info.samplesPerPixel << " samples" << '\n';
+        return false;
+    }
+    size_t expectedTiles = static_cast<size_t>(info.tilesAcross) * info.tilesDown;
+    if(tileOffsets.size() < expectedTiles || tileByteCounts.size() < tileOffsets.size()) {
+        std::cerr << "[C++] TIFF tile table is incomplete" << '\n';
+        return false;
+    }
+    // Only ever shrinks: the tables were read from the file, so expectedTiles is bounded by it
+    tileOffsets.resize(expectedTiles);
+    tileByteCounts.resize(expectedTiles);
+    // decodeTile allocates what the table says; a tile can't be bigger than the file
+    for(size_t i{0}; i < expectedTiles; i++) {
+        if(tileByteCounts[i] > fileBytes || tileOffsets[i] > fileBytes - tileByteCounts[i]) {
+            std::cerr << "[C++] TIFF tile " << i << " lies outside the file" << '\n';
+            return false;
+        }
+    }
+    return true;
+}
+
+bool TiffReader::decodeTile(int tileIndex, uint8_t* rgba) const {
+    const TiffInfo& info = tiffInfo;
+    const int spp = info.samplesPerPixel;
+    const int bytesPerSample = info.bitsPerSample / 8;
+    const size_t rowBytes = static_cast<size_t>(info.tileWidth) * spp * bytesPerSample;
+    // The last strip of a striped file may be short, tiles are always full size
+    int rows = info.tileHeight;
+    if(!info.tiled) {
+        rows = std::min(info.tileHeight, info.height - (tileIndex * info.tileHeight));
+    }
+    const size_t rawBytes = rowBytes * rows;
+
+    thread_local std::vector<uint8_t> compressed;
+    thread_local std::vector<uint8_t> raw;
+    compressed.resize(tileByteCounts[tileIndex]);
+    raw.assign(rawBytes, 0);
+    if(!readAt(tileOffsets[tileIndex], compressed.data(), compressed.size())) {
+        return false;
+    }
+
+    bool ok{true};
+    switch(info.compression) {
+    case NONE:
+        std::memcpy(raw.data(), compressed.data(), std::min(rawBytes, compressed.size()));
+        break;
+    case LZW:
+        ok = decodeLzw(compressed.data(), compressed.size(), raw.data(), rawBytes);
+        break;
+    case PACKBITS:
+        ok = decodePackBits(compressed.data(), compressed.size(), raw.data(), rawBytes);
+        break;
+    default: {
+        uLongf destLen = static_cast<uLongf>(rawBytes);
+        int status = uncompress(raw.data(), &destLen, compressed.data(),
+                                static_cast<uLong>(compressed.size()));
+        ok = status == Z_OK || (status == Z_BUF_ERROR && destLen == rawBytes);
+        break;
+    }
+    }
+    if(!ok) {
+        std::cerr << "[C++] TIFF tile " << tileIndex << " failed to decode" << '\n';
+        return false;
+    }
+
+    for(int r{0}; r < rows; r++) {
+        uint8_t* row = raw.data() + r * rowBytes;
+        if(bytesPerSample == 2) {
+            // Normalise to host order first, the predictor works on sample values
+            uint16_t* samples = reinterpret_cast<uint16_t*>(row);
+            for(size_t i{0}; i < rowBytes / 2; i++) {
+                const uint8_t* b = row + 2 * i;
+                samples[i] = bigEndian ? static_cast<uint16_t>((b[0] << 8) | b[1])
+                                       : static_cast<uint16_t>(b[0] | (b[1] << 8));
+            }
+            if(info.predictor == 2) {
+                for(size_t i = spp; i < rowBytes / 2; i++)
+                    samples[i] = static_cast<uint16_t>(samples[i] + samples[i - spp]);
+            }
+        } else if(info.predictor == 2) {
+            for(size_t i = spp; i < rowBytes; i++)
+                row[i] = static_cast<uint8_t>(row[i] + row[i - spp]);
+        }
+
+        uint8_t* dst = rgba + static_cast<size_t>(r) * info.tileWidth * 4;
+        for(int x{0}; x < info.tileWidth; x++, dst += 4) {
+            uint8_t sample[4]{0, 0, 0, 255};
+            for(int s{0}; s < spp; s++) {
+                sample[s] = bytesPerSample == 2
+                                ? static_cast<uint8_t>(reinterpret_cast<uint16_t*>(row)[x * spp + s] >> 8)
+                                : row[x * spp + s];
+            }
+            if(spp <= 2) {
+                uint8_t gray = info.photometric == 0 ? 255 - sample[0] : sample[0];
+                dst[0] = dst[1] = dst[2] = gray;
+                dst[3] = spp == 2 ? sample[1] : 255;
+            } else {
+                dst[0] = sample[0];
+                dst[1] = sample[1];
+                dst[2] = sample[2];
+                dst[3] = spp == 4 ? sample[3] : 255;
+            }
+        }
+    }
+    return true;
+}
+
+bool TiffReader::readWindow(int x, int y, int w, int h, uint8_t* rgba, int threads) const {
+    const TiffInfo& info = tiffInfo;
+    if(x < 0 || y < 0 || w <= 0 || h <= 0 || x + w > info.width || y + h > info.height) {
+        std::cerr << "[C++] TIFF window out of bounds" << '\n';
+        return false;
+    }
+    int firstCol = x / info.tileWidth, lastCol = (x + w - 1) / info.tileWidth;
+    int firstRow = y / info.tileHeight, lastRow = (y + h - 1) / info.tileHeight;
+    int colsCovered = lastCol - firstCol + 1;
+    int jobCount = colsCovered * (lastRow - firstRow + 1);
+
+    std::atomic<int> nextJob{0};
+    std::atomic<bool> failed{false};
+    auto decodeJobs = [&] {
+        std::vector<uint8_t> tile(static_cast<size_t>(info.tileWidth) * info.tileHeight * 4);
+        for(int job = nextJob++; job < jobCount && !failed; job = nextJob++) {
+            int tileCol = firstCol + job % colsCovered;
+            int tileRow = firstRow + job / colsCovered;
+            if(!decodeTile(tileRow * info.tilesAcross + tileCol, tile.data())) {
+                failed = true;
+                break;
+            }
+            // Copy the part of the tile that falls inside the window
+            int tileX = tileCol * info.tileWidth, tileY = tileRow * info.tileHeight;
+            int x0 = std::max(x, tileX), x1 = std::min(x + w, tileX + info.tileWidth);
+            int y0 = std::max(y, tileY), y1 = std::min(y + h, tileY + info.tileHeight);
+            for(int row = y0; row < y1; row++) {
+                const uint8_t* src =
+                    tile.data() + (static_cast<size_t>(row - tileY) * info.tileWidth + (x0 - tileX)) * 4;
+                uint8_t* dst = rgba + (static_cast<size_t>(row - y) * w + (x0 - x)) * 4;
+                std::memcpy(dst, src, static_cast<size_t>(x1 - x0) * 4);
+            }
+        }
+    };
+    // Runs on its own threads, so running out of memory has to become a failure here
+    auto worker = [&] {
+        try {
+            decodeJobs();
+        } catch(const std::bad_alloc&) {
+            std::cerr << "[C++] Out of memory decoding TIFF tiles" << '\n';
+            failed = true;
+        }
+    };
+
+    if(threads <= 0) {
+        threads = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+    }
+    threads = std::min(threads, jobCount);
+    if(threads <= 1) {
+        worker();
+    } else {
+        std::vector<std::thread> pool;
+        for(int t{0}; t < threads; t++)
+            pool.emplace_back(worker);
+        for(auto& t : pool)
+            t.join();
+    }
+    return !failed;
+}
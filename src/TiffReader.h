@@ -0,0 +1,63 @@
+#ifndef TIFF_READER_H
+#define TIFF_READER_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+bool isTiffFile(const std::string& path);
+
+struct TiffInfo {
+    int width{0};
+    int height{0};
+    int tileWidth{0}; // strips are read as full-width tiles
+    int tileHeight{0};
+    int tilesAcross{0};
+    int tilesDown{0};
+    int samplesPerPixel{1};
+    int bitsPerSample{8};
+    int compression{1};
+    int predictor{1};
+    int photometric{1};
+    bool tiled{false};
+    bool bigTiff{false};
+};
+
+// Reader for the first IFD of a classic or BigTIFF file (Cloud-Optimized GeoTIFFs included).
+// Nothing is read up front except the IFD: every tile is an independent unit fetched with
+// pread and decoded (none / LZW / deflate / PackBits, horizontal predictor) into RGBA.
+// Chunky 8- or 16-bit unsigned samples, 1-4 per pixel.
+class TiffReader {
+  public:
+    TiffReader() = default;
+    ~TiffReader();
+    TiffReader(const TiffReader&) = delete;
+    TiffReader& operator=(const TiffReader&) = delete;
+
+    bool open(const std::string& path);
+    const TiffInfo& info() const { return tiffInfo; }
+    int tileCount() const { return static_cast<int>(tileOffsets.size()); }
+
+    // One tile as tileWidth * tileHeight RGBA pixels; safe to call from several threads
+    bool decodeTile(int tileIndex, uint8_t* rgba) const;
+
+    // Decodes the window [x, x + w) x [y, y + h) into rgba (w * h * 4 bytes), reading and
+    // decoding only the tiles it intersects, spread over `threads` workers (0 = all cores)
+    bool readWindow(int x, int y, int w, int h, uint8_t* rgba, int threads = 0) const;
+
+    uint64_t getBytesRead() const { return bytesRead.load(); }
+
+  private:
+    int fd{-1};
+    bool bigEndian{false};
+    TiffInfo tiffInfo;
+    std::vector<uint64_t> tileOffsets;
+    std::vector<uint64_t> tileByteCounts;
+    mutable std::atomic<uint64_t> bytesRead{0};
+
+    bool readAt(uint64_t offset, void* dst, size_t bytes) const;
+    bool parseIfd(uint64_t offset);
+};
+#endif
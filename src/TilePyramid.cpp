@@ -0,0 +1,198 @@
+#include "TilePyramid.h"
+#include "Pixel.h"
+#include "RowBand.h"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <span>
+#include <stdexcept>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+void reduce2x2(const uint8_t* src, int srcWidth, int srcHeight, size_t srcStride, uint8_t* dst,
+               size_t dstStride) {
+    int dstWidth = (srcWidth + 1) / 2;
+    int dstHeight = (srcHeight + 1) / 2;
+    for(int y{0}; y < dstHeight; y++) {
+        const uint8_t* row0 = src + static_cast<size_t>(2 * y) * srcStride;
+        const uint8_t* row1 =
+            src + static_cast<size_t>(std::min(2 * y + 1, srcHeight - 1)) * srcStride;
+        uint8_t* out = dst + static_cast<size_t>(y) * dstStride;
+        int x{0};
+#ifdef __SSE2__
+        // Two output pixels per step: widen 4 source pixels from each row to 16 bits,
+        // add vertically, fold neighbouring pixels together, then (sum + 2) >> 2
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i two = _mm_set1_epi16(2);
+        for(; 2 * x + 4 <= srcWidth; x += 2) {
+            __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row0 + 8 * x));
+            __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row1 + 8 * x));
+            __m128i lo = _mm_add_epi16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero));
+            __m128i hi = _mm_add_epi16(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero));
+            lo = _mm_add_epi16(lo, _mm_srli_si128(lo, 8));
+            hi = _mm_add_epi16(hi, _mm_srli_si128(hi, 8));
+            __m128i sum = _mm_add_epi16(_mm_unpacklo_epi64(lo, hi), two);
+            __m128i avg = _mm_packus_epi16(_mm_srli_epi16(sum, 2), zero);
+            _mm_storel_epi64(reinterpret_cast<__m128i*>(out + 4 * x), avg);
+        }
+#endif
+        for(; x < dstWidth; x++) {
+            int x0 = 2 * x;
+            int x1 = std::min(2 * x + 1, srcWidth - 1);
+            for(int c{0}; c < 4; c++) {
+                int sum = row0[4 * x0 + c] + row0[4 * x1 + c] + row1[4 * x0 + c] + row1[4 * x1 + c];
+                out[4 * x + c] = static_cast<uint8_t>((sum + 2) >> 2);
+            }
+        }
+    }
+}
+
+TilePyramid::TilePyramid(const uint8_t* rgba, int width, int height, int _tileSize,
+                         MemoryAccountant* _accountant)
+    : tileSize(std::max(2, (_tileSize + 1) & ~1)), accountant(_accountant) {
+    // Level 0: re-lay the image out tile by tile
+    int levelWidth = width, levelHeight = height;
+    for(;;) {
+        Level level;
+        level.width = levelWidth;
+        level.height = levelHeight;
+        level.tilesAcross = (levelWidth + tileSize - 1) / tileSize;
+        level.tilesDown = (levelHeight + tileSize - 1) / tileSize;
+        level.tiles = allocateBuffer<uint8_t>(
+            static_cast<size_t>(level.tilesAcross) * level.tilesDown * tileBytes(), accountant,
+            BufferClass::SOURCE);
+        levels.push_back(std::move(level));
+        if(levelWidth <= tileSize && levelHeight <= tileSize) {
+            break;
+        }
+        levelWidth = (levelWidth + 1) / 2;
+        levelHeight = (levelHeight + 1) / 2;
+    }
+
+    const Level& base = levels[0];
+    size_t rowBytes = static_cast<size_t>(tileSize) * 4;
+    for(int y{0}; y < height; y++) {
+        const uint8_t* src = rgba + static_cast<size_t>(y) * width * 4;
+        for(int tx{0}; tx < base.tilesAcross; tx++) {
+            int columns = std::min(tileSize, width - tx * tileSize);
+            std::memcpy(tileAt(base, tx, y / tileSize) + (y % tileSize) * rowBytes,
+                        src + static_cast<size_t>(tx) * rowBytes, static_cast<size_t>(columns) * 4);
+        }
+    }
+    padEdgeTiles(levels[0]);
+
+    // Each parent tile is the four child tiles below it, each shrunk into one quadrant.
+    // Children are padded, so odd edges simply average the replicated pixels.
+    int half = tileSize / 2;
+    for(size_t l{1}; l < levels.size(); l++) {
+        const Level& child = levels[l - 1];
+        Level& parent = levels[l];
+        for(int ty{0}; ty < parent.tilesDown; ty++) {
+            for(int tx{0}; tx < parent.tilesAcross; tx++) {
+                uint8_t* dst = tileAt(parent, tx, ty);
+                for(int q{0}; q < 4; q++) {
+                    int cx = 2 * tx + (q & 1), cy = 2 * ty + (q >> 1);
+                    if(cx >= child.tilesAcross || cy >= child.tilesDown) {
+                        continue;
+                    }
+                    uint8_t* quadrant = dst + ((q >> 1) * half * rowBytes) + (q & 1) * half * 4;
+                    reduce2x2(tileAt(child, cx, cy), tileSize, tileSize, rowBytes, quadrant,
+                              rowBytes);
+                }
+            }
+        }
+        padEdgeTiles(parent);
+    }
+}
+
+uint8_t* TilePyramid::tileAt(const Level& level, int tileX, int tileY) const {
+    size_t index = static_cast<size_t>(tileY) * level.tilesAcross + tileX;
+    return level.tiles.get() + index * tileBytes();
+}
+
+const uint8_t* TilePyramid::pixelAt(const Level& level, int x, int y) const {
+    x = std::clamp(x, 0, level.width - 1);
+    y = std::clamp(y, 0, level.height - 1);
+    return tileAt(level, x / tileSize, y / tileSize) +
+           (static_cast<size_t>(y % tileSize) * tileSize + x % tileSize) * 4;
+}
+
+void TilePyramid::padEdgeTiles(Level& level) {
+    size_t rowBytes = static_cast<size_t>(tileSize) * 4;
+    int validColumns = level.width - (level.tilesAcross - 1) * tileSize;
+    int validRows = level.height - (level.tilesDown - 1) * tileSize;
+    for(int ty{0}; ty < level.tilesDown; ty++) {
+        uint8_t* tile = tileAt(level, level.tilesAcross - 1, ty);
+        for(int r{0}; r < tileSize && validColumns < tileSize; r++) {
+            uint8_t* row = tile + r * rowBytes;
+            for(int c = validColumns; c < tileSize; c++)
+                std::memcpy(row + 4 * c, row + 4 * (validColumns - 1), 4);
+        }
+    }
+    for(int tx{0}; tx < level.tilesAcross; tx++) {
+        uint8_t* tile = tileAt(level, tx, level.tilesDown - 1);
+        for(int r = validRows; r < tileSize; r++)
+            std::memcpy(tile + r * rowBytes, tile + (validRows - 1) * rowBytes, rowBytes);
+    }
+}
+
+void TilePyramid::setFilter(int kernelSize, const std::string& _filterType) {
+    filteredTiles.clear();
+    filterType = _filterType == "none" ? std::string{} : _filterType;
+    // Sobel's window is 3x3 whatever the size, so a wider halo would only be wasted reads
+    filterKernelSize = filterType == "sobelx" || filterType == "sobely" ? 3 : kernelSize;
+    if(filterType.empty()) {
+        return;
+    }
+    try {
+        RowBandFilter probe(1, 1, kernelSize, filterType, [](int, std::span<const Pixel>) {});
+    } catch(const std::invalid_argument& e) {
+        std::cerr << "[C++] " << e.what() << std::endl;
+        filterType.clear();
+    }
+}
+
+const uint8_t* TilePyramid::getTile(int level, int tileX, int tileY) {
+    if(level < 0 || level >= getLevels() || tileX < 0 || tileY < 0 ||
+       tileX >= levels[level].tilesAcross || tileY >= levels[level].tilesDown) {
+        return nullptr;
+    }
+    if(filterType.empty()) {
+        return tileAt(levels[level], tileX, tileY);
+    }
+    auto key = std::make_tuple(level, tileX, tileY);
+    auto it = filteredTiles.find(key);
+    if(it == filteredTiles.end()) {
+        it = filteredTiles.emplace(key, filterTile(level, tileX, tileY)).first;
+    }
+    return it->second.get();
+}
+
+Buffer<uint8_t> TilePyramid::filterTile(int levelIndex, int tileX, int tileY) {
+    const Level& level = levels[levelIndex];
+    // Halo from the neighbouring tiles, clamped at the image edge the same way the
+    // full-frame padding replicates it, so a filtered tile matches the full-frame result
+    const int halo = std::max(1, (filterKernelSize - 1) / 2);
+    const int window = tileSize + 2 * halo;
+    const int originX = tileX * tileSize - halo;
+    const int originY = tileY * tileSize - halo;
+
+    Buffer<uint8_t> out = allocateBuffer<uint8_t>(tileBytes(), accountant, BufferClass::OUTPUT);
+    auto sink = [&](int rowNum, std::span<const Pixel> row) {
+        if(rowNum < halo || rowNum >= halo + tileSize) {
+            return;
+        }
+        std::memcpy(out.get() + static_cast<size_t>(rowNum - halo) * tileSize * 4,
+                    row.data() + halo, static_cast<size_t>(tileSize) * 4);
+    };
+    RowBandFilter band(window, window, filterKernelSize, filterType, sink);
+    std::vector<Pixel> row(window);
+    for(int wy{0}; wy < window; wy++) {
+        for(int wx{0}; wx < window; wx++)
+            std::memcpy(&row[wx], pixelAt(level, originX + wx, originY + wy), 4);
+        band.pushRow(row);
+    }
+    return out;
+}
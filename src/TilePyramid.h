@@ -0,0 +1,69 @@
+#ifndef TILE_PYRAMID_H
+#define TILE_PYRAMID_H
+
+#include "BufferAllocator.h"
+#include "MemoryAccounting.h"
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <tuple>
+#include <vector>
+
+// Halves an RGBA image with a rounded 2x2 box average. Odd edges reuse the last row / column.
+// SSE2 when available, plain loop otherwise.
+void reduce2x2(const uint8_t* src, int srcWidth, int srcHeight, size_t srcStride, uint8_t* dst,
+               size_t dstStride);
+
+// Mip-mapped, tiled copy of an RGBA image for pan/zoom viewers.
+// Level 0 is full resolution and each level above halves it, until one tile covers the image.
+// Every level is stored tile-major (tileSize x tileSize RGBA, edge tiles padded by
+// replicating the last pixel), so a tile is one contiguous block that can be handed out
+// as is. With a filter set, getTile() filters just the requested tile (plus a halo of
+// kernelSize / 2 pixels from its neighbours) through a RowBandFilter and caches the result.
+// Not thread safe.
+class TilePyramid {
+  public:
+    TilePyramid(const uint8_t* rgba, int width, int height, int tileSize = 256,
+                MemoryAccountant* accountant = nullptr);
+
+    int getLevels() const { return static_cast<int>(levels.size()); }
+    int getTileSize() const { return tileSize; }
+    int getLevelWidth(int level) const { return levels[level].width; }
+    int getLevelHeight(int level) const { return levels[level].height; }
+    int getTilesAcross(int level) const { return levels[level].tilesAcross; }
+    int getTilesDown(int level) const { return levels[level].tilesDown; }
+
+    // An empty filterType (or "none") serves the unfiltered pyramid
+    void setFilter(int kernelSize, const std::string& filterType);
+
+    // tileSize * tileSize RGBA pixels, nullptr when (level, x, y) is outside the pyramid.
+    // The pointer stays valid until the filter changes.
+    const uint8_t* getTile(int level, int tileX, int tileY);
+
+    size_t getFilteredTileCount() const { return filteredTiles.size(); }
+
+  private:
+    struct Level {
+        int width{0};
+        int height{0};
+        int tilesAcross{0};
+        int tilesDown{0};
+        Buffer<uint8_t> tiles;
+    };
+
+    int tileSize;
+    MemoryAccountant* accountant;
+    std::vector<Level> levels;
+
+    int filterKernelSize{0};
+    std::string filterType;
+    std::map<std::tuple<int, int, int>, Buffer<uint8_t>> filteredTiles;
+
+    size_t tileBytes() const { return static_cast<size_t>(tileSize) * tileSize * 4; }
+    uint8_t* tileAt(const Level& level, int tileX, int tileY) const;
+    const uint8_t* pixelAt(const Level& level, int x, int y) const;
+    void padEdgeTiles(Level& level);
+    Buffer<uint8_t> filterTile(int level, int tileX, int tileY);
+};
+#endif
@@ -0,0 +1,108 @@
+#include "Trace.h"
+#include <iostream>
+
+#ifdef OPTIC_ENABLE_TRACE
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace {
+struct TraceEvent {
+    const char* name;
+    uint64_t begin;
+    uint64_t end;
+};
+
+// One per thread that ever traced; owned by the registry so a dump still sees threads
+// that have exited
+struct ThreadRing {
+    std::array<TraceEvent, traceRingEvents> events;
+    std::atomic<uint64_t> head{0}; // total events ever written, only its thread bumps it
+    uint32_t tid{0};
+    const char* name{nullptr};
+};
+
+std::mutex registryLock;
+std::vector<std::unique_ptr<ThreadRing>>& registry() {
+    static std::vector<std::unique_ptr<ThreadRing>> rings;
+    return rings;
+}
+
+const std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+
+uint64_t nowNs() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                     std::chrono::steady_clock::now() - epoch)
+                                     .count());
+}
+
+// The registry lock is only taken the first time a thread traces
+ThreadRing& localRing() {
+    thread_local ThreadRing* ring = [] {
+        auto owned = std::make_unique<ThreadRing>();
+        ThreadRing* raw = owned.get();
+        std::lock_guard<std::mutex> lk(registryLock);
+        raw->tid = static_cast<uint32_t>(registry().size()) + 1;
+        registry().push_back(std::move(owned));
+        return raw;
+    }();
+    return *ring;
+}
+} // namespace
+
+TraceScope::TraceScope(const char* _name) : name(_name), begin(nowNs()) {}
+
+TraceScope::~TraceScope() {
+    ThreadRing& ring = localRing();
+    uint64_t slot = ring.head.load(std::memory_order_relaxed);
+    ring.events[slot % traceRingEvents] = {name, begin, nowNs()};
+    ring.head.store(slot + 1, std::memory_order_release);
+}
+
+void traceThreadName(const char* name) { localRing().name = name; }
+
+bool writeTrace(const std::string& path) {
+    std::ofstream out(path);
+    if(!out) {
+        std::cerr << "[C++] Cannot open " << path << " for the trace" << '\n';
+        return false;
+    }
+    out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+    bool first{true};
+    auto separator = [&] {
+        out << (first ? "\n" : ",\n");
+        first = false;
+    };
+    out << std::fixed << std::setprecision(3);
+    std::lock_guard<std::mutex> lk(registryLock);
+    for(const auto& ring : registry()) {
+        if(ring->name) {
+            separator();
+            out << "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":" << ring->tid
+                << ",\"args\":{\"name\":\"" << ring->name << "\"}}";
+        }
+        uint64_t head = ring->head.load(std::memory_order_acquire);
+        uint64_t oldest = head > traceRingEvents ? head - traceRingEvents : 0;
+        for(uint64_t i = oldest; i < head; i++) {
+            const TraceEvent& event = ring->events[i % traceRingEvents];
+            separator();
+            // Chrome wants microseconds; three decimals keep ns resolution
+            out << "{\"ph\":\"X\",\"name\":\"" << event.name << "\",\"pid\":1,\"tid\":"
+                << ring->tid << ",\"ts\":" << event.begin / 1000.0
+                << ",\"dur\":" << (event.end - event.begin) / 1000.0 << "}";
+        }
+    }
+    out << "\n]}\n";
+    return static_cast<bool>(out);
+}
+#else
+bool writeTrace(const std::string& path) {
+    std::cerr << "[C++] Built without OPTIC_ENABLE_TRACE, no trace written to " << path << '\n';
+    return false;
+}
+#endif
@@ -0,0 +1,44 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <cstdint>
+#include <string>
+
+// Chrome trace-event recording (open the dump in Perfetto or chrome://tracing).
+// Built with OPTIC_ENABLE_TRACE (CMake option of the same name), every OPTIC_TRACE_SCOPE
+// appends one complete event to a ring buffer owned by the calling thread: no locks and no
+// shared cache lines on the hot path, and the oldest events are overwritten once a thread
+// has logged traceRingEvents of them. Without the flag the macros expand to nothing.
+// Names must be string literals (or otherwise outlive the dump).
+#ifdef OPTIC_ENABLE_TRACE
+class TraceScope {
+  public:
+    explicit TraceScope(const char* _name);
+    ~TraceScope();
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+
+  private:
+    const char* name;
+    uint64_t begin;
+};
+
+// Labels the calling thread's track in the viewer
+void traceThreadName(const char* name);
+
+#define OPTIC_TRACE_CONCAT_INNER(a, b) a##b
+#define OPTIC_TRACE_CONCAT(a, b) OPTIC_TRACE_CONCAT_INNER(a, b)
+#define OPTIC_TRACE_SCOPE(name) TraceScope OPTIC_TRACE_CONCAT(traceScope, __LINE__)(name)
+#define OPTIC_TRACE_THREAD_NAME(name) traceThreadName(name)
+#else
+#define OPTIC_TRACE_SCOPE(name) ((void)0)
+#define OPTIC_TRACE_THREAD_NAME(name) ((void)0)
+#endif
+
+constexpr uint32_t traceRingEvents = 1u << 15;
+
+// Writes every thread's events as Chrome trace JSON. Call once the traced work is done:
+// threads still recording may race with the dump. False when tracing is compiled out or
+// the file can't be written.
+bool writeTrace(const std::string& path);
+#endif
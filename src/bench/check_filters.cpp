@@ -0,0 +1,229 @@
+// Differential check of every box-blur engine against the scalar naiveBoxBlur reference, and
+// of the sobel engines against a 3x3 applyKernel reference (sobel ignores the size asked for).
+// Random image sizes, kernel sizes (including kernels wider than the image) and content
+// (noise, flat extremes, hard edges) are run through each engine; per engine it reports
+// how many pixels differ and the largest per-channel difference.
+// Usage: check_filters [--cases=N] [--seed=N] [--max-size=N] [--tolerance=N]
+// Exits non-zero when any engine's max abs error is above the tolerance (default 0).
+#include "FilterPipeline.h"
+#include "Filters.h"
+#include "ImageProcessor.h"
+#include "Kernel.h"
+#include "ThreadPool.h"
+#include "TilePyramid.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <mdspan>
+#include <random>
+#include <streambuf>
+#include <string>
+#include <vector>
+
+namespace {
+using Grid = std::mdspan<Pixel, std::dextents<size_t, 2>>;
+
+// Swallows the progress chatter ImageProcessor prints once per call
+class NullBuffer : public std::streambuf {
+  protected:
+    int overflow(int c) override { return c; }
+    std::streamsize xsputn(const char*, std::streamsize n) override { return n; }
+};
+
+std::vector<uint8_t> makeImage(std::mt19937& rng, int width, int height) {
+    std::vector<uint8_t> rgba(static_cast<size_t>(width) * height * 4);
+    std::uniform_int_distribution<int> byte(0, 255);
+    int pattern = std::uniform_int_distribution<int>(0, 3)(rng);
+    for(int y{0}; y < height; y++) {
+        for(int x{0}; x < width; x++) {
+            uint8_t* p = &rgba[(static_cast<size_t>(y) * width + x) * 4];
+            for(int c{0}; c < 3; c++) {
+                switch(pattern) {
+                case 0: p[c] = static_cast<uint8_t>(byte(rng)); break;   // noise
+                case 1: p[c] = 255; break;                               // SAT overflow bait
+                case 2: p[c] = ((x / 3 + y / 5) & 1) ? 255 : 0; break;   // hard edges
+                default: p[c] = static_cast<uint8_t>((x * 7 + y * 3 + c * 50) & 0xFF); break;
+                }
+            }
+            p[3] = 255;
+        }
+    }
+    return rgba;
+}
+
+// naiveBoxBlur (or the 3x3 sobel kernel) over an edge-replicated copy with a border of
+// exactly half the window
+std::vector<uint8_t> reference(const std::vector<uint8_t>& rgba, int width, int height, int k,
+                               const std::string& filter) {
+    bool sobel = filter == "sobelx" || filter == "sobely";
+    int border = sobel ? 1 : k / 2;
+    int paddedWidth = width + 2 * border;
+    int paddedHeight = height + 2 * border;
+    std::vector<Pixel> padded(static_cast<size_t>(paddedWidth) * paddedHeight);
+    Grid paddedGrid(padded.data(), paddedHeight, paddedWidth);
+    const Pixel* source = reinterpret_cast<const Pixel*>(rgba.data());
+    for(int i{0}; i < paddedHeight; i++) {
+        for(int j{0}; j < paddedWidth; j++) {
+            int r = std::clamp(i - border, 0, height - 1);
+            int c = std::clamp(j - border, 0, width - 1);
+            paddedGrid[i, j] = source[static_cast<size_t>(r) * width + c];
+        }
+    }
+    std::vector<uint8_t> out(rgba.size());
+    Grid outGrid(reinterpret_cast<Pixel*>(out.data()), height, width);
+    auto sobelKernel = filter == "sobelx" ? KernelFactory::SobelX() : KernelFactory::SobelY();
+    for(int i{0}; i < height; i++) {
+        for(int j{0}; j < width; j++) {
+            if(sobel) {
+                applyKernel(outGrid, paddedGrid, i, j, sobelKernel);
+            } else {
+                naiveBoxBlur(outGrid, paddedGrid, i, j);
+            }
+        }
+    }
+    return out;
+}
+
+struct Engine {
+    std::string name;
+    // Filters rgba (width x height) in place with a k x k box, or sobel when `filter` says so
+    std::function<void(std::vector<uint8_t>&, int, int, int)> run;
+    std::string filter{"boxblur"};
+    long cases{0};
+    long pixels{0};
+    long mismatches{0};
+    int maxAbsError{0};
+};
+
+std::vector<Engine> makeEngines() {
+    std::vector<Engine> engines;
+    auto viaProcessor = [](const std::string& filter, bool streaming,
+                           ImageProcessor::SatMethod method) {
+        return [=](std::vector<uint8_t>& rgba, int width, int height, int k) {
+            ImageProcessor processor;
+            processor.setStreaming(streaming);
+            processor.setSatMethod(method);
+            processor.loadRgba(rgba.data(), width, height);
+            processor.applyFilter(k, filter);
+            const uint8_t* out = reinterpret_cast<const uint8_t*>(processor.getPixelDataPtr());
+            std::memcpy(rgba.data(), out, rgba.size());
+        };
+    };
+    using Method = ImageProcessor::SatMethod;
+    engines.push_back({"sat/serial", viaProcessor("sat", false, Method::SERIAL)});
+    engines.push_back({"sat/wavefront", viaProcessor("sat", false, Method::WAVEFRONT_PIPELINE)});
+    engines.push_back({"sat/two_pass", viaProcessor("sat", false, Method::TWO_PASS_BARRIER)});
+    engines.push_back({"boxblur/kernel", viaProcessor("boxblur", false, Method::SERIAL)});
+    engines.push_back({"sat/row_band", viaProcessor("sat", true, Method::SERIAL)});
+    engines.push_back({"boxblur/row_band", viaProcessor("boxblur", true, Method::SERIAL)});
+
+    // Level 0 of the tile pyramid, stitched back together from its halo-filtered tiles
+    auto viaPyramid = [](const std::string& stage) {
+        return [stage](std::vector<uint8_t>& rgba, int width, int height, int k) {
+            int tileSize = 16 << (width % 3);
+            TilePyramid pyramid(rgba.data(), width, height, tileSize);
+            pyramid.setFilter(k, stage);
+            for(int y{0}; y < height; y++) {
+                for(int x{0}; x < width; x++) {
+                    const uint8_t* tile = pyramid.getTile(0, x / tileSize, y / tileSize);
+                    size_t offset =
+                        (static_cast<size_t>(y % tileSize) * tileSize + x % tileSize) * 4;
+                    std::memcpy(&rgba[(static_cast<size_t>(y) * width + x) * 4], tile + offset,
+                                4);
+                }
+            }
+        };
+    };
+    for(const char* filter : {"sat", "boxblur"}) {
+        std::string stage = filter;
+        engines.push_back({stage + "/pipeline",
+                           [stage](std::vector<uint8_t>& rgba, int width, int height, int k) {
+                               FilterPipeline pipeline =
+                                   FilterPipeline::parse(stage + ":" + std::to_string(k));
+                               pipeline.run(rgba.data(), width, height, nullptr,
+                                            sharedThreadPool());
+                           }});
+        engines.push_back({stage + "/pyramid", viaPyramid(stage)});
+    }
+    // Asked for with k x k like the rest, every path has to come out as the 3x3 kernel
+    for(const char* filter : {"sobelx", "sobely"}) {
+        std::string stage = filter;
+        engines.push_back({stage + "/kernel", viaProcessor(stage, false, Method::SERIAL), stage});
+        engines.push_back({stage + "/row_band", viaProcessor(stage, true, Method::SERIAL), stage});
+        engines.push_back({stage + "/pyramid", viaPyramid(stage), stage});
+    }
+    return engines;
+}
+} // namespace
+
+int main(int argc, char* argv[]) {
+    int cases{60};
+    unsigned seed{1};
+    int maxSize{160};
+    int tolerance{0};
+    for(int i = 1; i < argc; ++i) {
+        std::string arg{argv[i]};
+        std::string value{arg.substr(arg.find('=') + 1)};
+        if(arg.starts_with("--cases=")) {
+            cases = std::max(1, std::stoi(value));
+        } else if(arg.starts_with("--seed=")) {
+            seed = static_cast<unsigned>(std::stoul(value));
+        } else if(arg.starts_with("--max-size=")) {
+            maxSize = std::max(1, std::stoi(value));
+        } else if(arg.starts_with("--tolerance=")) {
+            tolerance = std::max(0, std::stoi(value));
+        } else {
+            std::cerr << "Unknown option " << arg << '\n';
+            return 1;
+        }
+    }
+
+    NullBuffer nullBuffer;
+    std::streambuf* console = std::cout.rdbuf(&nullBuffer);
+    std::vector<Engine> engines = makeEngines();
+    std::mt19937 rng(seed);
+    std::uniform_int_distribution<int> size(1, maxSize);
+    std::uniform_int_distribution<int> radius(0, 7);
+    for(int n{0}; n < cases; n++) {
+        int width = size(rng);
+        int height = size(rng);
+        int k = 2 * radius(rng) + 1;
+        std::vector<uint8_t> source = makeImage(rng, width, height);
+        std::map<std::string, std::vector<uint8_t>> references;
+        for(auto& engine : engines) {
+            auto [slot, added] = references.try_emplace(engine.filter);
+            if(added) {
+                slot->second = reference(source, width, height, k, engine.filter);
+            }
+            const std::vector<uint8_t>& expected = slot->second;
+            std::vector<uint8_t> actual = source;
+            engine.run(actual, width, height, k);
+            engine.cases++;
+            engine.pixels += static_cast<long>(width) * height;
+            for(size_t p{0}; p < actual.size(); p += 4) {
+                int error{0};
+                for(int c{0}; c < 4; c++)
+                    error = std::max(error, std::abs(actual[p + c] - expected[p + c]));
+                engine.mismatches += error > 0;
+                engine.maxAbsError = std::max(engine.maxAbsError, error);
+            }
+        }
+    }
+    std::cout.rdbuf(console);
+
+    bool ok{true};
+    std::cout << "check_filters: " << cases << " cases, seed " << seed << ", sizes 1.." << maxSize
+              << ", kernels 1..15\n";
+    for(const auto& engine : engines) {
+        bool pass = engine.maxAbsError <= tolerance;
+        ok = ok && pass;
+        std::cout << (pass ? "  PASS " : "  FAIL ") << engine.name << ": max abs error "
+                  << engine.maxAbsError << ", " << engine.mismatches << " / " << engine.pixels
+                  << " pixels differ\n";
+    }
+    return ok ? 0 : 1;
+}
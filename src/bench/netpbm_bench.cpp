@@ -0,0 +1,91 @@
+// Decode throughput of the native netpbm reader against stbi_load_from_memory.
+// Usage: netpbm_bench [file.ppm|pgm|pam] [repeats]
+// Without a file a deterministic 8000x6000 P6 is synthesised in memory.
+#include "MappedFile.h"
+#include "NetpbmReader.h"
+#include "stb_image.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace {
+std::vector<uint8_t> synthesizePPM(int width, int height) {
+    std::string header = "P6\n" + std::to_string(width) + " " + std::to_string(height) + "\n255\n";
+    std::vector<uint8_t> bytes(header.begin(), header.end());
+    bytes.resize(header.size() + static_cast<size_t>(width) * height * 3);
+    uint32_t state = 0x9E3779B9u;
+    for(size_t i = header.size(); i < bytes.size(); ++i) {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        bytes[i] = static_cast<uint8_t>(state);
+    }
+    return bytes;
+}
+
+template <typename Fn> double medianMs(int repeats, Fn&& run) {
+    std::vector<double> times;
+    for(int i = 0; i < repeats; ++i) {
+        auto start = std::chrono::steady_clock::now();
+        run();
+        auto end = std::chrono::steady_clock::now();
+        times.push_back(std::chrono::duration<double, std::milli>(end - start).count());
+    }
+    std::sort(times.begin(), times.end());
+    return times[times.size() / 2];
+}
+} // namespace
+
+int main(int argc, char* argv[]) {
+    int repeats = argc > 2 ? std::max(1, std::atoi(argv[2])) : 5;
+
+    MappedFile file;
+    std::vector<uint8_t> synthetic;
+    std::span<const uint8_t> bytes;
+    if(argc > 1) {
+        if(!file.open(argv[1])) {
+            return 1;
+        }
+        bytes = file.bytes();
+    } else {
+        synthetic = synthesizePPM(8000, 6000);
+        bytes = synthetic;
+    }
+
+    NetpbmImage image;
+    if(!parseNetpbm(bytes, image)) {
+        std::cerr << "Not a binary netpbm file\n";
+        return 1;
+    }
+    double megapixels = static_cast<double>(image.width) * image.height / 1e6;
+    std::cout << image.width << "x" << image.height << " depth " << image.depth << " maxval "
+              << image.maxval << ", " << repeats << " repeats\n";
+
+    auto rgba = std::make_unique_for_overwrite<uint8_t[]>(static_cast<size_t>(image.width) *
+                                                          image.height * 4);
+    double nativeMs = medianMs(repeats, [&] {
+        NetpbmImage view;
+        parseNetpbm(bytes, view);
+        expandNetpbmToRGBA(view, rgba.get());
+    });
+    std::cout << "native netpbm: " << nativeMs << " ms (" << megapixels / (nativeMs / 1000.0)
+              << " MP/s)\n";
+
+    // stb only reads 8-bit P5/P6
+    if(image.depth == 1 || image.depth == 3) {
+        double stbMs = medianMs(repeats, [&] {
+            int w, h, c;
+            stbi_uc* decoded = stbi_load_from_memory(bytes.data(), static_cast<int>(bytes.size()),
+                                                     &w, &h, &c, 4);
+            stbi_image_free(decoded);
+        });
+        std::cout << "stb_image:     " << stbMs << " ms (" << megapixels / (stbMs / 1000.0)
+                  << " MP/s)\n";
+        std::cout << "speedup:       " << stbMs / nativeMs << "x\n";
+    }
+    return 0;
+}
@@ -0,0 +1,335 @@
+// Filter microbenchmarks: every filter type, kernel size and SatMethod over a ladder of
+// square synthetic images, printed as JSON so runs from different builds can be diffed.
+// Usage: ppm_bench [--sizes=256,1024,4096,16384] [--kernels=3,5,9,15]
+//                  [--filters=gaussian,boxblur,sobelx,sobely,sat] [--repeats=N] [--warmup=N]
+//                  [--mem-limit-mb=N] [--roofline] [--stream-mb=N]
+// Sizes whose predicted peak footprint is over the memory limit (default: half of RAM)
+// are skipped and listed under "skipped". Hardware counters (perf_event_open) are summed over
+// the measured repeats and reported per pixel; any the machine won't give us come out null.
+// --roofline first measures STREAM-style read, write and copy bandwidth (arrays of
+// --stream-mb each, default the larger of 64 MB and 4x the LLC) on one thread and on every
+// core, then adds to each result the bytes per pixel from ImageProcessor::predictTraffic,
+// the GB/s that implies, its share of the copy peak for as many threads as the engine uses,
+// and "bound": "bandwidth" from 60% of that peak up, "compute" below.
+#include "ImageProcessor.h"
+#include "PerfCounters.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <streambuf>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+// Swallows the progress chatter ImageProcessor prints, which would otherwise be timed too
+class NullBuffer : public std::streambuf {
+  protected:
+    int overflow(int c) override { return c; }
+    std::streamsize xsputn(const char*, std::streamsize n) override { return n; }
+};
+
+std::vector<int> parseList(const std::string& text) {
+    std::vector<int> values;
+    std::stringstream in(text);
+    for(std::string item; std::getline(in, item, ',');)
+        values.push_back(std::stoi(item));
+    return values;
+}
+
+std::vector<std::string> parseNames(const std::string& text) {
+    std::vector<std::string> names;
+    std::stringstream in(text);
+    for(std::string item; std::getline(in, item, ',');)
+        names.push_back(item);
+    return names;
+}
+
+// Same xorshift stream for a given size on every run and every build
+std::vector<uint8_t> synthesizeRGBA(int width, int height) {
+    std::vector<uint8_t> rgba(static_cast<size_t>(width) * height * 4);
+    uint32_t state = 0x9E3779B9u ^ static_cast<uint32_t>(width * 2654435761u);
+    for(size_t i = 0; i < rgba.size(); i += 4) {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        rgba[i] = static_cast<uint8_t>(state);
+        rgba[i + 1] = static_cast<uint8_t>(state >> 8);
+        rgba[i + 2] = static_cast<uint8_t>(state >> 16);
+        rgba[i + 3] = 255;
+    }
+    return rgba;
+}
+
+struct Case {
+    std::string filter;
+    int kernelSize;
+    std::string method; // "" unless filter == "sat"
+    ImageProcessor::SatMethod satMethod{ImageProcessor::SatMethod::TWO_PASS_BARRIER};
+};
+
+// Sums one counter over the repeats; stays -1 once any repeat couldn't read it
+struct CounterTotal {
+    int64_t total{0};
+    void add(int64_t value) { total = total < 0 || value < 0 ? -1 : total + value; }
+};
+
+// A JSON number per pixel, or null for a counter that wasn't available
+std::string perPixel(const CounterTotal& counter, double pixels) {
+    return counter.total < 0 ? "null" : std::to_string(counter.total / pixels);
+}
+
+struct Bandwidth {
+    int threads{1};
+    double readGBs{0};
+    double writeGBs{0};
+    double copyGBs{0};
+};
+
+// Best of several trials, as STREAM reports it. Each thread works on its own contiguous
+// slice of the arrays and first-touches it, so pages land on that thread's node.
+Bandwidth measureBandwidth(size_t arrayBytes, int threads, int trials = 5) {
+    size_t count = arrayBytes / sizeof(double);
+    std::unique_ptr<double[]> a(new double[count]);
+    std::unique_ptr<double[]> b(new double[count]);
+    std::vector<double> sums(threads);
+    auto slice = [&](int t, auto body) {
+        body(count * t / threads, count * (t + 1) / threads, t);
+    };
+    auto timeParallel = [&](auto body) {
+        auto start = std::chrono::steady_clock::now();
+        std::vector<std::thread> workers;
+        for(int t{0}; t < threads; t++)
+            workers.emplace_back([&, t] { slice(t, body); });
+        for(auto& worker : workers)
+            worker.join();
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    };
+    timeParallel([&](size_t begin, size_t end, int) {
+        std::fill(a.get() + begin, a.get() + end, 1.0);
+        std::fill(b.get() + begin, b.get() + end, 2.0);
+    });
+
+    double readS{1e30}, writeS{1e30}, copyS{1e30};
+    for(int trial{0}; trial < trials; trial++) {
+        readS = std::min(readS, timeParallel([&](size_t begin, size_t end, int t) {
+            // Four chains, so the adds' latency doesn't cap the read rate
+            double sum[4]{};
+            size_t i{begin};
+            for(; i + 4 <= end; i += 4)
+                for(int lane{0}; lane < 4; lane++)
+                    sum[lane] += a[i + lane];
+            for(; i < end; i++)
+                sum[0] += a[i];
+            sums[t] = sum[0] + sum[1] + sum[2] + sum[3];
+        }));
+        writeS = std::min(writeS, timeParallel([&](size_t begin, size_t end, int) {
+            std::fill(b.get() + begin, b.get() + end, static_cast<double>(trial));
+        }));
+        copyS = std::min(copyS, timeParallel([&](size_t begin, size_t end, int) {
+            std::copy(a.get() + begin, a.get() + end, b.get() + begin);
+        }));
+    }
+    // Keeps the read loop from being optimized away
+    volatile double sink = 0;
+    for(double sum : sums)
+        sink = sink + sum;
+
+    double bytes = static_cast<double>(count * sizeof(double));
+    return {threads, bytes / readS / 1e9, bytes / writeS / 1e9, 2 * bytes / copyS / 1e9};
+}
+
+std::string bandwidthJson(const Bandwidth& bw) {
+    std::ostringstream out;
+    out << "{\"threads\": " << bw.threads << ", \"read_gbps\": " << bw.readGBs
+        << ", \"write_gbps\": " << bw.writeGBs << ", \"copy_gbps\": " << bw.copyGBs << "}";
+    return out.str();
+}
+
+// Threads the engine keeps busy: the filter traversal, and the wavefront / two-pass SAT,
+// run on every worker of the shared pool
+int engineThreads() { return sharedThreadPool().size(); }
+
+// Nearest-rank percentile of sorted samples
+double percentile(const std::vector<double>& sorted, double p) {
+    size_t rank = static_cast<size_t>(std::ceil(p * sorted.size()));
+    return sorted[std::clamp<size_t>(rank, 1, sorted.size()) - 1];
+}
+} // namespace
+
+int main(int argc, char* argv[]) {
+    std::vector<int> sizes{256, 1024, 4096, 16384};
+    std::vector<int> kernels{3, 5, 9, 15};
+    std::vector<std::string> filters{"gaussian", "boxblur", "sobelx", "sobely", "sat"};
+    int repeats{5};
+    int warmup{1};
+    bool roofline{false};
+    size_t streamBytes{0};
+    size_t memLimit = static_cast<size_t>(sysconf(_SC_PHYS_PAGES)) * sysconf(_SC_PAGESIZE) / 2;
+    for(int i = 1; i < argc; ++i) {
+        std::string arg{argv[i]};
+        std::string value{arg.substr(arg.find('=') + 1)};
+        if(arg.starts_with("--sizes=")) {
+            sizes = parseList(value);
+        } else if(arg.starts_with("--kernels=")) {
+            kernels = parseList(value);
+        } else if(arg.starts_with("--filters=")) {
+            filters = parseNames(value);
+        } else if(arg.starts_with("--repeats=")) {
+            repeats = std::max(1, std::stoi(value));
+        } else if(arg.starts_with("--warmup=")) {
+            warmup = std::max(0, std::stoi(value));
+        } else if(arg.starts_with("--mem-limit-mb=")) {
+            memLimit = std::stoull(value) << 20;
+        } else if(arg == "--roofline") {
+            roofline = true;
+        } else if(arg.starts_with("--stream-mb=")) {
+            streamBytes = std::stoull(value) << 20;
+        } else {
+            std::cerr << "Unknown option " << arg << '\n';
+            return 1;
+        }
+    }
+
+    // Measured before any image is allocated, so the arrays don't compete with them for RAM
+    std::vector<Bandwidth> peaks;
+    if(roofline) {
+        if(streamBytes == 0) {
+            long llc = sysconf(_SC_LEVEL3_CACHE_SIZE);
+            size_t llcBytes = llc > 0 ? static_cast<size_t>(llc) : 0;
+            streamBytes = std::min(std::max(size_t{64} << 20, 4 * llcBytes), memLimit / 4);
+        }
+        int cores = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+        for(int threads : {1, cores}) {
+            if(peaks.empty() || threads != peaks.back().threads) {
+                peaks.push_back(measureBandwidth(streamBytes, threads));
+                std::cerr << "stream " << threads << " thread(s): read " << peaks.back().readGBs
+                          << " GB/s, write " << peaks.back().writeGBs << " GB/s, copy "
+                          << peaks.back().copyGBs << " GB/s\n";
+            }
+        }
+    }
+
+    std::vector<Case> cases;
+    const std::pair<const char*, ImageProcessor::SatMethod> satMethods[] = {
+        {"serial", ImageProcessor::SatMethod::SERIAL},
+        {"wavefront", ImageProcessor::SatMethod::WAVEFRONT_PIPELINE},
+        {"two_pass", ImageProcessor::SatMethod::TWO_PASS_BARRIER}};
+    for(const auto& filter : filters) {
+        if(filter == "sobelx" || filter == "sobely") {
+            cases.push_back({filter, 3, ""});
+            continue;
+        }
+        for(int k : kernels) {
+            if(filter != "sat") {
+                cases.push_back({filter, k, ""});
+                continue;
+            }
+            for(const auto& [name, method] : satMethods)
+                cases.push_back({filter, k, name, method});
+        }
+    }
+
+    NullBuffer nullBuffer;
+    std::streambuf* console = std::cout.rdbuf(&nullBuffer);
+    std::ostringstream json;
+    json << "{\n  \"benchmark\": \"ppm_bench\",\n  \"repeats\": " << repeats
+         << ",\n  \"warmup\": " << warmup;
+    if(roofline) {
+        json << ",\n  \"stream\": {\"array_mb\": " << (streamBytes >> 20) << ", \"runs\": [";
+        for(size_t i{0}; i < peaks.size(); i++)
+            json << (i ? ", " : "") << bandwidthJson(peaks[i]);
+        json << "]}";
+    }
+    json << ",\n  \"results\": [";
+    std::string skipped;
+    bool first{true};
+
+    // Opened before the processor starts the shared pool, so the counters follow its workers
+    PerfCounters counters;
+    ImageProcessor processor;
+    for(int size : sizes) {
+        std::vector<uint8_t> source = synthesizeRGBA(size, size);
+        double megapixels = static_cast<double>(size) * size / 1e6;
+        for(const auto& c : cases) {
+            if(processor.predictPeakMemory(size, size, c.filter, c.kernelSize).total > memLimit) {
+                skipped += std::string(skipped.empty() ? "" : ", ") + "\"" + c.filter +
+                           (c.method.empty() ? "" : "/" + c.method) + ":" +
+                           std::to_string(c.kernelSize) + "@" + std::to_string(size) + "\"";
+                continue;
+            }
+            processor.setSatMethod(c.satMethod);
+            std::vector<double> times;
+            CounterTotal cycles, instructions, l1d, llc, dtlb, branches;
+            for(int r{0}; r < warmup + repeats; r++) {
+                // Filters work in place, so every run starts from the same pixels
+                processor.loadRgba(source.data(), size, size);
+                counters.start();
+                auto start = std::chrono::steady_clock::now();
+                processor.applyFilter(c.kernelSize, c.filter);
+                auto end = std::chrono::steady_clock::now();
+                PerfCounters::Sample sample = counters.stop();
+                if(r >= warmup) {
+                    times.push_back(std::chrono::duration<double, std::milli>(end - start).count());
+                    cycles.add(sample.cycles);
+                    instructions.add(sample.instructions);
+                    l1d.add(sample.l1dMisses);
+                    llc.add(sample.llcMisses);
+                    dtlb.add(sample.dtlbMisses);
+                    branches.add(sample.branchMisses);
+                }
+            }
+            double measuredPixels = megapixels * 1e6 * repeats;
+            std::string ipc = cycles.total > 0 && instructions.total >= 0
+                                  ? std::to_string(static_cast<double>(instructions.total) /
+                                                   cycles.total)
+                                  : "null";
+            std::sort(times.begin(), times.end());
+            double median = percentile(times, 0.5);
+            json << (first ? "\n" : ",\n") << "    {\"filter\": \"" << c.filter
+                 << "\", \"method\": \"" << c.method << "\", \"size\": " << size
+                 << ", \"kernel\": " << c.kernelSize << ", \"median_ms\": " << median
+                 << ", \"p95_ms\": " << percentile(times, 0.95)
+                 << ", \"mpix_per_s\": " << megapixels / (median / 1000.0)
+                 << ", \"ipc\": " << ipc
+                 << ", \"cycles_per_pixel\": " << perPixel(cycles, measuredPixels)
+                 << ", \"l1d_misses_per_pixel\": " << perPixel(l1d, measuredPixels)
+                 << ", \"llc_misses_per_pixel\": " << perPixel(llc, measuredPixels)
+                 << ", \"dtlb_misses_per_pixel\": " << perPixel(dtlb, measuredPixels)
+                 << ", \"branch_misses_per_pixel\": " << perPixel(branches, measuredPixels);
+            std::string bound;
+            if(roofline) {
+                size_t traffic = processor.predictTraffic(size, size, c.filter, c.kernelSize);
+                double gbps = traffic / (median / 1000.0) / 1e9;
+                // The copy peak of the largest measured thread count the engine can use
+                const Bandwidth* peak = &peaks.front();
+                for(const Bandwidth& bw : peaks)
+                    if(bw.threads <= engineThreads())
+                        peak = &bw;
+                double share = 100.0 * gbps / peak->copyGBs;
+                bound = share >= 60.0 ? "bandwidth" : "compute";
+                json << ", \"bytes_per_pixel\": " << traffic / (megapixels * 1e6)
+                     << ", \"gb_per_s\": " << gbps << ", \"pct_of_peak\": " << share
+                     << ", \"bound\": \"" << bound << "\"";
+            }
+            json << "}";
+            first = false;
+            // Progress on stderr so long sweeps are visibly alive
+            std::cerr << c.filter << (c.method.empty() ? "" : "/" + c.method) << " k"
+                      << c.kernelSize << " " << size << "x" << size << ": " << median
+                      << " ms, IPC " << ipc << (bound.empty() ? "" : ", " + bound + "-bound")
+                      << "\n";
+        }
+    }
+    json << "\n  ],\n  \"skipped\": [" << skipped << "]\n}\n";
+
+    std::cout.rdbuf(console);
+    std::cout << json.str();
+    return 0;
+}
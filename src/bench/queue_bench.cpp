@@ -0,0 +1,200 @@
+// Contention benchmark for the tile-job queues: MpmcQueue (lock-free ring), a mutex-guarded
+// stack shaped like concurrencyIntermediates' ThreadSafeStack, and the blocking BoundedQueue
+// the pipelines use today. For every thread count, that many producers and as many consumers
+// move the same total number of jobs through one queue; printed as JSON.
+// Usage: queue_bench [--threads=1,2,4,8,16,32] [--items=N] [--capacity=N] [--repeats=N]
+// Every run checks that each job came out exactly once and exits 1 if one didn't.
+#include "BoundedQueue.h"
+#include "MpmcQueue.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <concepts>
+#include <cstdint>
+#include <iostream>
+#include <mutex>
+#include <optional>
+#include <sstream>
+#include <stack>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace {
+// What a pipeline stage hands on: which tile, and where its pixels are
+struct TileJob {
+    int level{0};
+    int tileX{0};
+    int tileY{0};
+    uint64_t payload{0};
+};
+
+// ThreadSafeStack from the demo, with a capacity so it is compared like for like
+template <std::movable T> class MutexStack {
+  private:
+    std::stack<T> items;
+    std::mutex m;
+    size_t capacity;
+
+  public:
+    explicit MutexStack(size_t _capacity) : capacity(_capacity) {}
+    bool tryPush(T item) {
+        std::scoped_lock lk(m);
+        if(items.size() >= capacity)
+            return false;
+        items.push(std::move(item));
+        return true;
+    }
+    bool tryPop(T& out) {
+        std::scoped_lock lk(m);
+        if(items.empty())
+            return false;
+        out = std::move(items.top());
+        items.pop();
+        return true;
+    }
+};
+
+std::vector<int> parseList(const std::string& text) {
+    std::vector<int> values;
+    std::stringstream in(text);
+    for(std::string item; std::getline(in, item, ',');)
+        values.push_back(std::stoi(item));
+    return values;
+}
+
+struct Run {
+    double ms{0};
+    bool correct{false};
+};
+
+// Producer p pushes jobs p, p + producers, ...; consumers sum the payloads they pop
+template <typename Push, typename Pop, typename Drained>
+Run runContention(int threads, uint64_t items, Push&& push, Pop&& pop, Drained&& drained) {
+    std::atomic<uint64_t> popped{0}, checksum{0};
+    std::vector<std::thread> producers, consumers;
+    auto start = std::chrono::steady_clock::now();
+    for(int c{0}; c < threads; c++)
+        consumers.emplace_back([&] {
+            uint64_t sum{0};
+            TileJob job;
+            while(pop(job, popped, items))
+                sum += job.payload;
+            checksum += sum;
+        });
+    for(int p{0}; p < threads; p++)
+        producers.emplace_back([&, p] {
+            for(uint64_t i = p; i < items; i += threads) {
+                TileJob job{0, static_cast<int>(i & 0xFF), static_cast<int>(i >> 8), i + 1};
+                push(job);
+            }
+        });
+    for(auto& t : producers)
+        t.join();
+    drained();
+    for(auto& t : consumers)
+        t.join();
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start)
+                    .count();
+    return {ms, checksum == items * (items + 1) / 2};
+}
+
+// Spins on a non-blocking queue, yielding so oversubscribed runs still make progress
+template <typename Queue> Run runNonBlocking(Queue& queue, int threads, uint64_t items) {
+    return runContention(
+        threads, items,
+        [&](TileJob& job) {
+            while(!queue.tryPush(job))
+                std::this_thread::yield();
+        },
+        [&](TileJob& job, std::atomic<uint64_t>& popped, uint64_t total) {
+            // Claim a job before waiting for it, so exactly `total` pops succeed
+            if(popped++ >= total)
+                return false;
+            while(!queue.tryPop(job))
+                std::this_thread::yield();
+            return true;
+        },
+        [] {});
+}
+
+Run runBlocking(BoundedQueue<TileJob>& queue, int threads, uint64_t items) {
+    return runContention(
+        threads, items, [&](TileJob& job) { queue.push(job); },
+        [&](TileJob& job, std::atomic<uint64_t>&, uint64_t) {
+            std::optional<TileJob> item = queue.pop();
+            if(!item)
+                return false;
+            job = *item;
+            return true;
+        },
+        [&] { queue.close(); });
+}
+} // namespace
+
+int main(int argc, char* argv[]) {
+    std::vector<int> threadCounts{1, 2, 4, 8, 16, 32};
+    uint64_t items{1'000'000};
+    size_t capacity{1024};
+    int repeats{3};
+    for(int i = 1; i < argc; ++i) {
+        std::string arg{argv[i]};
+        std::string value{arg.substr(arg.find('=') + 1)};
+        if(arg.starts_with("--threads=")) {
+            threadCounts = parseList(value);
+        } else if(arg.starts_with("--items=")) {
+            items = std::stoull(value);
+        } else if(arg.starts_with("--capacity=")) {
+            capacity = std::stoull(value);
+        } else if(arg.starts_with("--repeats=")) {
+            repeats = std::max(1, std::stoi(value));
+        } else {
+            std::cerr << "Unknown option " << arg << '\n';
+            return 1;
+        }
+    }
+
+    std::ostringstream json;
+    json << "{\n  \"benchmark\": \"queue_bench\",\n  \"items\": " << items
+         << ",\n  \"capacity\": " << capacity << ",\n  \"repeats\": " << repeats
+         << ",\n  \"results\": [";
+    bool first{true};
+    bool allCorrect{true};
+    for(int threads : threadCounts) {
+        threads = std::max(1, threads);
+        for(const std::string name : {"mpmc", "mutex_stack", "bounded_queue"}) {
+            std::vector<double> times;
+            for(int r{0}; r < repeats; r++) {
+                Run run;
+                if(name == "mpmc") {
+                    MpmcQueue<TileJob> queue(capacity);
+                    run = runNonBlocking(queue, threads, items);
+                } else if(name == "mutex_stack") {
+                    MutexStack<TileJob> queue(capacity);
+                    run = runNonBlocking(queue, threads, items);
+                } else {
+                    BoundedQueue<TileJob> queue(capacity);
+                    run = runBlocking(queue, threads, items);
+                }
+                if(!run.correct) {
+                    std::cerr << name << " with " << threads << " threads lost or duplicated jobs\n";
+                    allCorrect = false;
+                }
+                times.push_back(run.ms);
+            }
+            std::sort(times.begin(), times.end());
+            double median = times[times.size() / 2];
+            json << (first ? "\n" : ",\n") << "    {\"queue\": \"" << name
+                 << "\", \"producers\": " << threads << ", \"consumers\": " << threads
+                 << ", \"median_ms\": " << median
+                 << ", \"mops_per_s\": " << items / (median / 1000.0) / 1e6 << "}";
+            first = false;
+            // Progress on stderr so long sweeps are visibly alive
+            std::cerr << name << " " << threads << "x" << threads << ": " << median << " ms\n";
+        }
+    }
+    json << "\n  ]\n}\n";
+    std::cout << json.str();
+    return allCorrect ? 0 : 1;
+}
@@ -1,39 +1,332 @@
+#include <charconv>
+#include <optional>
 #include <span>
+#include <string>
+#include <string_view>
+#include <type_traits>
 #include <iostream>
-#include <fstream>
 #include <vector>
+#include "Autotuner.h"
+#include "BatchPipeline.h"
+#include "BufferAllocator.h"
+#include "FilterServer.h"
 #include "ImageProcessor.h"
+#include "PerfCounters.h"
+#include "PngStreamDecoder.h"
+#include "PngWriter.h"
+#include "PpmWriter.h"
+#include "StageTimings.h"
+#include "StreamingPipeline.h"
+#include "TiffReader.h"
+#include "Trace.h"
+
+namespace {
+// The whole string as a number, or nothing: a typo ends in the usage message, not terminate()
+template <typename T> std::optional<T> parseNumber(std::string_view text) {
+    T value{};
+    auto [end, ec] = std::from_chars(text.data(), text.data() + text.size(), value);
+    if(ec != std::errc() || end != text.data() + text.size()) {
+        return std::nullopt;
+    }
+    return value;
+}
+
+void printUsage() {
+    std::cerr << "\nUsage: ppm_cli <input> <output> <filter> <size>\n"
+              << "       ppm_cli <input> <output> --pipeline \"gaussian:5|sobelx|invert\"\n"
+              << "    [--no-fuse]  (run pointwise stages as separate passes)\n"
+              << "    [--stream] [--bench] [--mem-report] [--mmap-out] [--timings=json]\n"
+              << "    [--trace=out.json]  (builds with OPTIC_ENABLE_TRACE)\n"
+              << "    [--hugepage-threshold-mb=N] [--populate] [--numa-node=N]\n"
+              << "    [--window=x,y,w,h]  (tiled TIFF / COG input)\n"
+              << "    [--png-level=0-9]  (output ending in .png)\n"
+              << "       ppm_cli --batch <in-dir> <out-dir> <filter> <size> [-j N]\n"
+              << "       ppm_cli --batch-pipeline <out-dir> <filter> <size> <inputs...>\n"
+              << "    [--io-depth=N] [--no-io-uring]\n"
+              << "       ppm_cli --serve <socket> [-j N]\n"
+              << "       ppm_cli --tune  (SAT autotuning table, see Autotuner.h)\n";
+}
+} // namespace
 
 int main(int argc, char* argv[]){
-    if(argc!=5){
+    OPTIC_TRACE_THREAD_NAME("main");
+    std::vector<std::string> positional;
+    bool streaming{false};
+    bool benchmark{false};
+    bool memReport{false};
+    std::vector<int> window; // x, y, w, h for tiled TIFF input
+    bool batchPipeline{false};
+    bool batchDirectory{false};
+    int jobs{0};
+    bool ioUring{true};
+    int ioDepth{8};
+    int pngLevel{6};
+    std::string pipelineSpec;
+    bool fuse{true};
+    bool timingsJson{false};
+    std::string tracePath;
+    bool tune{false};
+    std::string serveSocket;
+    PpmOutputMode outputMode{PpmOutputMode::BUFFERED};
+    std::string badValue; // first option whose number didn't parse
+    for(int i = 1; i < argc; ++i) {
+        std::string arg{argv[i]};
+        auto number = [&](std::string_view text, auto& out) {
+            if(auto value = parseNumber<std::remove_reference_t<decltype(out)>>(text)) {
+                out = *value;
+            } else if(badValue.empty()) {
+                badValue = arg;
+            }
+        };
+        std::string_view value{arg};
+        value.remove_prefix(arg.find('=') == std::string::npos ? 0 : arg.find('=') + 1);
+        if(arg == "--stream") {
+            streaming = true;
+        } else if(arg == "--mmap-out") {
+            outputMode = PpmOutputMode::MMAP;
+        } else if(arg == "--mem-report") {
+            memReport = true;
+        } else if(arg == "--bench") {
+            benchmark = true;
+        } else if(arg.starts_with("--hugepage-threshold-mb=")) {
+            size_t megabytes{allocatorConfig().hugePageThreshold >> 20};
+            number(value, megabytes);
+            allocatorConfig().hugePageThreshold = megabytes << 20;
+        } else if(arg == "--populate") {
+            allocatorConfig().populate = true;
+        } else if(arg.starts_with("--numa-node=")) {
+            number(value, allocatorConfig().numaNode);
+        } else if(arg == "--serve" && i + 1 < argc) {
+            serveSocket = argv[++i];
+        } else if(arg == "--batch") {
+            batchDirectory = true;
+        } else if(arg == "-j" && i + 1 < argc) {
+            number(argv[++i], jobs);
+        } else if(arg.starts_with("-j") && arg.size() > 2) {
+            number(std::string_view(arg).substr(2), jobs);
+        } else if(arg == "--batch-pipeline") {
+            batchPipeline = true;
+        } else if(arg == "--no-io-uring") {
+            ioUring = false;
+        } else if(arg.starts_with("--io-depth=")) {
+            number(value, ioDepth);
+        } else if(arg == "--pipeline" && i + 1 < argc) {
+            pipelineSpec = argv[++i];
+        } else if(arg.starts_with("--pipeline=")) {
+            pipelineSpec = arg.substr(arg.find('=') + 1);
+        } else if(arg == "--tune") {
+            tune = true;
+        } else if(arg.starts_with("--trace=")) {
+            tracePath = arg.substr(arg.find('=') + 1);
+        } else if(arg == "--timings=json") {
+            timingsJson = true;
+        } else if(arg == "--no-fuse") {
+            fuse = false;
+        } else if(arg.starts_with("--png-level=")) {
+            number(value, pngLevel);
+        } else if(arg.starts_with("--window=")) {
+            std::string spec{arg.substr(arg.find('=') + 1)};
+            for(size_t start{0}, comma{0}; comma != std::string::npos; start = comma + 1) {
+                comma = spec.find(',', start);
+                int coordinate{0};
+                number(std::string_view(spec).substr(start, comma - start), coordinate);
+                window.push_back(coordinate);
+            }
+        } else {
+            positional.push_back(arg);
+        }
+    }
+    if(!badValue.empty()) {
+        std::cerr << "Invalid number in " << badValue << "\n";
+        printUsage();
+        exit(1);
+    }
+    // Positional sizes go through the same check, for the modes that take one
+    auto positionalNumber = [&](size_t index) {
+        std::optional<int> size = parseNumber<int>(positional[index]);
+        if(!size) {
+            std::cerr << "Invalid number " << positional[index] << "\n";
+            printUsage();
+            exit(1);
+        }
+        return *size;
+    };
+    // Benchmarks the SAT candidates per size class (256^2 .. 4096^2) into the tuning table
+    if(tune) {
+        std::string path{tuningTablePath()};
+        TuningTable table;
+        table.load(path);
+        std::string cpu{cpuKey()};
+        for(int sizeClassKey{8}; sizeClassKey <= 12; sizeClassKey++) {
+            SatTuning tuning = tuneSat(sizeClassKey);
+            table.set(cpu, sizeClassKey, tuning);
+            std::cout << "[tune] " << (1 << sizeClassKey) << "^2: " << satMethodName(tuning.method)
+                      << ", batch " << tuning.batchSize << ", " << tuning.threads << " threads\n";
+        }
+        bool saved = table.save(path);
+        std::cout << "[tune] " << cpu << (saved ? " -> " : " NOT saved to ") << path << "\n";
+        return saved ? 0 : 1;
+    }
+    // Daemon: requests arrive over a Unix socket and reuse warm processors (see FilterServer.h)
+    if(!serveSocket.empty()) {
+        return runFilterServer(serveSocket, jobs) ? 0 : 1;
+    }
+    // Batch: <in-dir> <out-dir> <filter> <size>, one warm processor per worker thread
+    if(batchDirectory && positional.size() == 4) {
+        BatchWorkerStats stats;
+        bool ok = runBatchWorkers(positional[0], positional[1], positional[2],
+                                  positionalNumber(3), jobs, &stats);
+        std::cout << "\n[batch] " << stats.images << " images (" << stats.failed << " failed) in "
+                  << stats.wallMs << " ms: " << stats.images * 1000.0 / stats.wallMs
+                  << " images/s, " << stats.bytesRead / 1048576.0 / (stats.wallMs / 1000.0)
+                  << " MB/s in\n[batch] latency p50 " << stats.p50Ms << " ms, p99 " << stats.p99Ms
+                  << " ms\n";
+        return ok ? 0 : 1;
+    }
+    // Batch: <out-dir> <filter> <size> <inputs...>, read/decode/filter/encode/write overlapped
+    if(batchPipeline && positional.size() >= 4) {
+        std::vector<std::string> inputs(positional.begin() + 3, positional.end());
+        BatchStats stats;
+        bool ok = runBatchPipeline(inputs, positional[0], positional[1], positionalNumber(2), &stats,
+                                   ioUring, ioDepth);
+        std::cout << "\n[batch] " << stats.images << " images (" << stats.failed << " failed) in "
+                  << stats.wallMs << " ms: " << stats.images * 1000.0 / stats.wallMs
+                  << " images/s via " << (stats.ioUring ? "io_uring" : "pread pool")
+                  << ", depth " << ioDepth << "\n[batch] read " << stats.bytesRead / 1048576.0
+                  << " MB, wrote " << stats.bytesWritten / 1048576.0 << " MB"
+                  << "\n[batch] busy ms: read " << stats.busyMs[0] << " | decode "
+                  << stats.busyMs[1] << " | filter " << stats.busyMs[2] << " | encode "
+                  << stats.busyMs[3] << " | write " << stats.busyMs[4] << "\n";
+        return ok ? 0 : 1;
+    }
+    // A pipeline spec replaces the <filter> <size> pair
+    size_t expectedArgs = pipelineSpec.empty() ? 4 : 2;
+    if(positional.size() != expectedArgs || (!window.empty() && window.size() != 4)){
         std::cout << "Error!";
+        printUsage();
         exit(1);
     }
-    std::string inputPath {argv[1]};
-    std::string outputPath {argv[2]};
+    std::string inputPath {positional[0]};
+    std::string outputPath {positional[1]};
 
-    std::ifstream file(inputPath, std::ios::binary | std::ios::ate);
-    std::streamsize size = file.tellg();
-    file.seekg(0, std::ios::beg);
+    std::string filterType {pipelineSpec.empty() ? positional[2] : "pipeline"};
+    int kernelSize {pipelineSpec.empty() ? positionalNumber(3) : 0};
+    std::cout << kernelSize << filterType;
+
+    // PNG input in streaming mode never materialises the full frame:
+    // decode, filter and encode run as a pipeline over row bands
+    bool streamPng{streaming && pipelineSpec.empty() && isPngFile(inputPath)};
+    if(streamPng && !isStreamablePng(inputPath)) {
+        std::cout << "\n[C++] Interlaced or unsupported PNG layout, decoding the full frame\n";
+        streamPng = false;
+    }
+    // The streaming sink writes P6; PNG output goes through savePng on the full frame
+    if(streamPng && outputPath.ends_with(".png")) {
+        std::cout << "\n[C++] PNG output, decoding the full frame\n";
+        streamPng = false;
+    }
+    if(streamPng) {
+        StreamingStats stats;
+        // Benchmark-only: opening the counters costs a syscall each
+        std::optional<PerfCounters> counters;
+        if(benchmark) {
+            counters.emplace().start();
+        }
+        bool ok = runStreamingPng(inputPath, outputPath, filterType, kernelSize, outputMode, &stats);
+        if(counters) {
+            std::cout << "\n[bench] streaming pipeline: " << counters->stop() << "\n";
+        }
+        if(memReport) {
+            std::cout << "\n[mem] streaming buffers for " << stats.width << "x" << stats.height
+                      << ": " << stats.bufferBytes / (1024.0 * 1024.0) << " MB\n";
+        }
+        if(!tracePath.empty() && writeTrace(tracePath)) {
+            std::cout << "\n[trace] written to " << tracePath << "\n";
+        }
+        if(timingsJson) {
+            std::cout << "\n" << stats.timings.toJson() << "\n";
+        }
+        return ok ? 0 : 1;
+    }
 
-    std::vector<char> buffer(size);
-    file.read(buffer.data(),size);
+    // Benchmark-only. Opened before the processor starts the shared pool, so the counters
+    // follow its workers; start() and stop() bracket the stage each one measures
+    std::optional<PerfCounters> counters, writeCounters;
+    if(benchmark) {
+        counters.emplace();
+        writeCounters.emplace();
+    }
     ImageProcessor processor;
-    std::cout << static_cast<int>(atoi(argv[4]))  << argv[3];
-
-    processor.loadImage(buffer, size);
-    processor.applyFilter(static_cast<int>(atoi(argv[4])),argv[3]);
-    std::ofstream outputImage(outputPath, std::ios::binary);
-    char* data = reinterpret_cast<char*>(processor.getPixelDataPtr());
-    int totalPixels = processor.getWidth() * processor.getHeight();
-    outputImage<<"P6\n" << processor.getWidth() << " " << processor.getHeight() << "\n255\n";
-    for (int i = 0; i < totalPixels; ++i) {
-        int offset = i * 4; 
-        outputImage << data[offset];\
-        outputImage << data[offset + 1];
-        outputImage << data[offset + 2];
-    }
-    outputImage.close();
+    processor.setStreaming(streaming);
+    processor.setPipelineFusion(fuse);
+
+    // Decoded straight out of an mmap of the input, netpbm never touches stb_image
+    bool loaded{false};
+    if(!window.empty() && isTiffFile(inputPath)) {
+        loaded = processor.loadTiffWindow(inputPath, window[0], window[1], window[2], window[3]);
+    } else {
+        loaded = processor.loadImageFromFile(inputPath);
+    }
+    if(!loaded) {
+        exit(1);
+    }
+    if(memReport && pipelineSpec.empty()) {
+        std::cout << "\n[mem] predicted peak: "
+                  << processor.predictPeakMemory(processor.getWidth(), processor.getHeight(),
+                                                 filterType, kernelSize)
+                  << "\n";
+    }
+    if(counters) {
+        counters->start();
+    }
+    if(!pipelineSpec.empty()) {
+        if(!processor.runPipeline(pipelineSpec)) {
+            exit(1);
+        }
+    } else if(!processor.applyFilter(kernelSize, filterType)) {
+        exit(1);
+    }
+    if(counters) {
+        std::cout << "\n[bench] " << (pipelineSpec.empty() ? "applyFilter" : "runPipeline") << ": "
+                  << counters->stop() << "\n";
+    }
+    if(memReport) {
+        std::cout << "\n[mem] current: " << processor.getMemoryUsage()
+                  << "\n[mem] peak:    " << processor.getPeakMemoryUsage() << "\n";
+    }
+    const uint8_t* data = reinterpret_cast<const uint8_t*>(processor.getPixelDataPtr());
+    if(writeCounters) {
+        writeCounters->start();
+    }
+    if(outputPath.ends_with(".png")) {
+        if(!processor.savePng(outputPath, pngLevel)) {
+            exit(1);
+        }
+        if(writeCounters) {
+            std::cout << "[bench] writePNG (level " << pngLevel << "): " << writeCounters->stop()
+                      << "\n";
+        }
+    } else {
+        bool written{false};
+        {
+            ScopedTimer timer(processor.getTimings(), "write");
+            OPTIC_TRACE_SCOPE("write ppm");
+            written =
+                writePPM(outputPath, data, processor.getWidth(), processor.getHeight(), outputMode);
+        }
+        if(!written) {
+            exit(1);
+        }
+        if(writeCounters) {
+            std::cout << "[bench] writePPM: " << writeCounters->stop() << "\n";
+        }
+    }
+    if(!tracePath.empty() && writeTrace(tracePath)) {
+        std::cout << "\n[trace] written to " << tracePath << "\n";
+    }
+    if(timingsJson) {
+        std::cout << "\n" << processor.getLastTimings() << "\n";
+    }
     
 }
 
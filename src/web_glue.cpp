@@ -5,12 +5,44 @@ using namespace emscripten;
 
 
 EMSCRIPTEN_BINDINGS(my_module) {
+    value_object<MemoryUsage>("MemoryUsage")
+        .field("source", &MemoryUsage::source)
+        .field("padded", &MemoryUsage::padded)
+        .field("sat", &MemoryUsage::sat)
+        .field("scratch", &MemoryUsage::scratch)
+        .field("output", &MemoryUsage::output)
+        .field("total", &MemoryUsage::total);
+
+    enum_<ImageProcessor::SatMethod>("SatMethod")
+        .value("SERIAL", ImageProcessor::SatMethod::SERIAL)
+        .value("WAVEFRONT_PIPELINE", ImageProcessor::SatMethod::WAVEFRONT_PIPELINE)
+        .value("TWO_PASS_BARRIER", ImageProcessor::SatMethod::TWO_PASS_BARRIER);
+
     class_<ImageProcessor>("ImageProcessor")
         .constructor<>()
-        .function("loadImage", &ImageProcessor::loadImage)
+        .function("loadImage",
+                  select_overload<bool(const std::vector<char>&, int)>(&ImageProcessor::loadImage))
+        .function("loadImageFromPtr", &ImageProcessor::loadImageFromPtr)
         .function("applyFilter", &ImageProcessor::applyFilter)
+        .function("runPipeline", &ImageProcessor::runPipeline)
+        .function("savePng", &ImageProcessor::savePng)
+        .function("setStreaming", &ImageProcessor::setStreaming)
+        .function("setPipelineFusion", &ImageProcessor::setPipelineFusion)
+        .function("setSatMethod", &ImageProcessor::setSatMethod)
         .function("getWidth", &ImageProcessor::getWidth)
         .function("getHeight", &ImageProcessor::getHeight)
         .function("getPixelDataPtr", &ImageProcessor::getPixelDataPtr)
+        .function("getLastTimings", &ImageProcessor::getLastTimings)
+        .function("getMemoryUsage", &ImageProcessor::getMemoryUsage)
+        .function("getPeakMemoryUsage", &ImageProcessor::getPeakMemoryUsage)
+        .function("resetPeakMemoryUsage", &ImageProcessor::resetPeakMemoryUsage)
+        .function("predictPeakMemory", &ImageProcessor::predictPeakMemory)
+        .function("buildPyramid", &ImageProcessor::buildPyramid)
+        .function("setPyramidFilter", &ImageProcessor::setPyramidFilter)
+        .function("getTile", &ImageProcessor::getTile)
+        .function("getPyramidLevels", &ImageProcessor::getPyramidLevels)
+        .function("getPyramidTileSize", &ImageProcessor::getPyramidTileSize)
+        .function("getPyramidLevelWidth", &ImageProcessor::getPyramidLevelWidth)
+        .function("getPyramidLevelHeight", &ImageProcessor::getPyramidLevelHeight)
         ;
 }